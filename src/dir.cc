@@ -3,96 +3,145 @@
 #include <sstream>
 #include <filesystem>
 #include <algorithm>
+#include <system_error>
 
+#include <cstdint>
 #include <cstring>
 #include <cerrno>
 #include <cassert>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 #include "./dir.h"
+#include "./flist.h"
 #include "./global.h"
+#include "./scan.h"
+#include "./unlink.h"
 #include "./util.h"
 #include "./worker.h"
+#ifdef CONFIG_IO_URING
+#include "./uring.h"
+#endif
 
-const unsigned long MAX_BUFFER_SIZE = 128lu * 1024;
+const unsigned long MAX_BUFFER_SIZE = 64lu << 20;
+const size_t WRITE_DATA_BLOCK_SIZE = 4096; // unit of compress and dedup
 
 namespace {
 const std::string WRITE_PATHS_PREFIX = "dirload";
 
-int read_file(const std::string&, XThread&);
-int write_file(const std::string&, const std::string&, XThread&, const Dir&);
-int create_inode(const std::string&, const std::string&, WritePathsType);
+int read_file(const std::string&, off_t, XThread&);
+int read_file_stream(const std::string&, XThread&);
+int read_file_psync(const std::string&, off_t, XThread&, bool);
+int read_fd_seq(int, XThread&, bool);
+int read_fd_pattern(int, off_t, XThread&, bool);
+int read_file_mmap(const std::string&, XThread&);
+int read_file_splice(const std::string&, XThread&, bool);
+int write_file(const std::string&, const std::string&, FileType, XThread&,
+	const Dir&);
+int write_file_psync(const std::string&, const std::string&, XThread&);
+int write_fd(int, XThread&, bool);
+int write_fd_data(int, long, off_t&, XThread&, bool, bool);
+int update_file(const std::string&, XThread&);
+int get_write_flags(int);
+int allocate_fd(int, off_t);
+int deallocate_fd(int, off_t);
+int create_inode(const std::string&, FileType, const std::string&,
+	WritePathsType);
 int fsync_inode(const std::string&);
+int sync_write_path(XThread&, const std::string&, int, const std::string&);
+int sync_write_dir(XThread&, const std::string&);
+int check_sync_batch(XThread&);
+int wait_write_behind(const std::string&);
+int commit_sync_batch(XThread&);
 std::string get_write_paths_base(void);
 }
 
 ThreadDir::ThreadDir(unsigned long rbufsiz, unsigned long wbufsiz):
-	_read_buffer(std::vector<char>(rbufsiz, 0)),
-	_write_buffer(std::vector<char>(wbufsiz, 0x41)),
+	_read_buffer(Buffer(rbufsiz, 0, get_page_size(), opt::buffer_type)),
+	_write_buffer(Buffer(wbufsiz, opt::write_data == WriteData::Pattern ?
+		0x41 : 0, get_page_size(), opt::buffer_type)),
 	_write_paths{},
-	_write_paths_counter(0) {
+	_write_paths_counter(0),
+	_num_update_paths(0),
+	_sync_batch{},
+	_null_fd(-1),
+	_pipe_fd{-1, -1} {
+#ifdef __linux__
+	if (rbufsiz > 0 && (opt::read_engine == ReadEngine::Splice ||
+		opt::read_engine == ReadEngine::Sendfile)) {
+		_null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+		if (_null_fd < 0)
+			throw std::system_error(errno, std::generic_category(),
+				"/dev/null");
+	}
+	if (rbufsiz > 0 && opt::read_engine == ReadEngine::Splice) {
+		if (pipe2(_pipe_fd, O_CLOEXEC) < 0) {
+			auto error = errno;
+			close(_null_fd);
+			throw std::system_error(error, std::generic_category(),
+				"pipe2");
+		}
+		// pipe capacity limits bytes per splice(2), ignore failure
+		fcntl(_pipe_fd[1], F_SETPIPE_SZ, static_cast<int>(rbufsiz));
+	}
+#endif
+#ifdef CONFIG_IO_URING
+	if (rbufsiz > 0 && opt::read_engine == ReadEngine::Uring)
+		_uring = std::make_unique<UringEngine>(opt::iodepth, rbufsiz,
+			O_RDONLY);
+	else if (wbufsiz > 0 && opt::write_engine == WriteEngine::Uring)
+		_uring = std::make_unique<UringEngine>(opt::iodepth, wbufsiz,
+			O_WRONLY);
+#endif
+}
+
+ThreadDir::ThreadDir(ThreadDir&& tdir):
+	_read_buffer(std::move(tdir._read_buffer)),
+	_write_buffer(std::move(tdir._write_buffer)),
+	_write_paths(std::move(tdir._write_paths)),
+	_write_paths_counter(tdir._write_paths_counter),
+	_num_update_paths(tdir._num_update_paths),
+	_sync_batch(std::move(tdir._sync_batch)),
+	_null_fd(tdir._null_fd),
+	_pipe_fd{tdir._pipe_fd[0], tdir._pipe_fd[1]}
+#ifdef CONFIG_IO_URING
+	, _uring(std::move(tdir._uring))
+#endif
+	{
+	tdir._null_fd = -1;
+	tdir._pipe_fd[0] = -1;
+	tdir._pipe_fd[1] = -1;
+}
+
+ThreadDir::~ThreadDir(void) {
+	for (auto fd : {_null_fd, _pipe_fd[0], _pipe_fd[1]})
+		if (fd != -1)
+			close(fd);
 }
 
-Dir::Dir(bool random):
-	_random_write_data{},
+Dir::Dir(void):
 	_write_paths_ts{} {
-	if (random) {
-		// doubled
-		for (unsigned long i = 0; i < MAX_BUFFER_SIZE * 2; i++)
-			_random_write_data.push_back(get_random(
-				static_cast<unsigned char>(32),
-				static_cast<unsigned char>(128)));
-	}
 	_write_paths_ts = get_time_string();
 }
 
-unsigned long cleanup_write_paths(const std::vector<const ThreadDir*>& tdv) {
+int cleanup_write_paths(const std::vector<const ThreadDir*>& tdv,
+	unsigned long& num_remain, UnlinkStat& us) {
 	std::vector<std::string> l;
 	for (const auto& tdir : tdv)
 		tdir->splice_write_paths(l);
-	auto num_remain = 0lu;
-	if (opt::keep_write_paths) {
-		num_remain += static_cast<unsigned long>(l.size());
-	} else {
-		unlink_write_paths(l, -1);
-		num_remain += static_cast<unsigned long>(l.size());
-	}
-	return num_remain;
-}
-
-int unlink_write_paths(std::vector<std::string>& l, long count) {
-	auto lsize = static_cast<long>(l.size());
-	auto n = lsize; // unlink all by default
-	if (count > 0) {
-		n = count;
-		if (n > lsize)
-			n = lsize;
-	}
-	std::cout << "Unlink " << n << " write paths" << std::endl;
-	std::sort(l.begin(), l.end());
-
-	while (n > 0) {
-		auto& f = l[l.size() - 1];
-		switch (get_raw_file_type(f)) {
-		case FileType::Dir:
-			[[fallthrough]];
-		case FileType::Reg:
-			assert(path_exists(f));
-			[[fallthrough]];
-		case FileType::Symlink:
-			// don't resolve symlink (test symlink itself, not target)
-			if (!path_exists(f))
-				continue;
-			if (std::filesystem::remove(f))
-				l.pop_back();
-			n--;
-			break;
-		default:
-			return -EINVAL;
-		}
+	if (!opt::keep_write_paths) {
+		auto ret = unlink_write_paths(l, -1,
+			static_cast<unsigned int>(tdv.size()), us);
+		if (ret < 0)
+			return ret;
 	}
+	num_remain = static_cast<unsigned long>(l.size());
 	return 0;
 }
 
@@ -108,11 +157,55 @@ void assert_file_path(const std::string& f) {
 
 int read_entry(const std::string& f, XThread& thr) {
 	assert_file_path(f);
-	auto t = get_raw_file_type(f);
+#ifdef CONFIG_IO_URING
+	// statx(2) asynchronously, continue from read_entry_type()
+	if (opt::read_engine == ReadEngine::Uring)
+		return thr.get_mut_dir().get_uring()->stat_entry(f, thr);
+#endif
+	// a single lstat(2) result is used for the entry
+	struct stat st;
+	auto ret = lstat(f.c_str(), &st) < 0 ? -errno : 0;
 
 	// stats by dirwalk itself are not counted
 	thr.get_mut_stat().inc_num_stat();
+	// entry removed since flist creation or dirwalk is skipped
+	if (ret == -ENOENT)
+		return 0;
+	if (ret < 0)
+		return ret;
+
+	return read_entry_type(f, get_mode_file_type(st.st_mode), st.st_size,
+		thr);
+}
+
+// binary flist has type and size of each path if opted in,
+// stat only mode always stats since that's the workload
+int read_flist_entry(const std::string& f, const Flist& fl, size_t idx,
+	XThread& thr) {
+	FileType t;
+	off_t size;
+	if (opt::flist_cached_stat && !opt::stat_only &&
+		fl.get_stat(idx, t, size)) {
+		assert_file_path(f);
+		return read_entry_type(f, t, size, thr);
+	}
+	return read_entry(f, thr);
+}
 
+// d_type from dirwalk replaces lstat(2) unless stat only,
+// size of regular file is unknown until opened
+int read_walk_entry(const std::string& f, FileType t, XThread& thr) {
+	if (opt::stat_only || (t != FileType::Reg && t != FileType::Dir &&
+		t != FileType::Symlink))
+		return read_entry(f, thr);
+	assert_file_path(f);
+	// entry removed since dirwalk is skipped as in read_entry()
+	auto ret = read_entry_type(f, t, -1, thr);
+	return ret == -ENOENT ? 0 : ret;
+}
+
+int read_entry_type(const std::string& f, FileType t, off_t size,
+	XThread& thr) {
 	// ignore . entries if specified
 	if (opt::ignore_dot && t != FileType::Dir && is_dot_path(f))
 		return 0;
@@ -127,10 +220,14 @@ int read_entry(const std::string& f, XThread& thr) {
 		x = std::filesystem::read_symlink(f);
 		thr.get_mut_stat().add_num_read_bytes(x.size());
 		if (!is_abspath(x)) {
-			x = join_path(get_dirpath(f), x);
+			// lexical, kernel resolves .. in the target
+			x = join_path(get_dirpath(f, true), x, true);
 			assert(is_abspath(x));
 		}
-		t = get_file_type(x); // update type
+		struct stat st;
+		t = get_file_type(x, st); // update type
+		if (t != FileType::Unsupported)
+			size = st.st_size;
 		thr.get_mut_stat().inc_num_stat(); // count twice for symlink
 		assert(t != FileType::Symlink); // symlink chains resolved
 		if (!opt::follow_symlink)
@@ -141,7 +238,7 @@ int read_entry(const std::string& f, XThread& thr) {
 
 	switch (t) {
 	case FileType::Reg:
-		return read_file(f, thr);
+		return read_file(f, size, thr);
 	case FileType::Dir:
 		[[fallthrough]];
 	case FileType::Device:
@@ -157,8 +254,7 @@ int read_entry(const std::string& f, XThread& thr) {
 }
 
 namespace {
-int read_file(const std::string& f, XThread& thr) {
-	auto [buf, bufsiz] = thr.get_mut_dir().get_read_buffer();
+long get_read_resid(size_t bufsiz) {
 	auto resid = opt::read_size; // negative resid means read until EOF
 	if (resid == 0) {
 		resid = get_random<long>(0, bufsiz) + 1;
@@ -166,6 +262,37 @@ int read_file(const std::string& f, XThread& thr) {
 		assert(resid <= static_cast<long>(bufsiz));
 	}
 	assert(resid == -1 || resid > 0);
+	return resid;
+}
+
+int read_file(const std::string& f, off_t size, XThread& thr) {
+	switch (opt::read_engine) {
+	case ReadEngine::Stream:
+		return read_file_stream(f, thr);
+	case ReadEngine::Psync:
+		return read_file_psync(f, size, thr, false);
+	case ReadEngine::Direct:
+		return read_file_psync(f, size, thr, true);
+	case ReadEngine::Uring:
+#ifdef CONFIG_IO_URING
+		return thr.get_mut_dir().get_uring()->read_file(f,
+			get_read_resid(opt::read_buffer_size), thr);
+#else
+		break;
+#endif
+	case ReadEngine::Mmap:
+		return read_file_mmap(f, thr);
+	case ReadEngine::Splice:
+		return read_file_splice(f, thr, false);
+	case ReadEngine::Sendfile:
+		return read_file_splice(f, thr, true);
+	}
+	return -EINVAL;
+}
+
+int read_file_stream(const std::string& f, XThread& thr) {
+	auto [buf, bufsiz] = thr.get_mut_dir().get_read_buffer();
+	auto resid = get_read_resid(bufsiz);
 
 	// start read
 	std::ifstream ifs;
@@ -198,6 +325,271 @@ int read_file(const std::string& f, XThread& thr) {
 	}
 	return 0;
 }
+
+int read_file_psync(const std::string& f, off_t size, XThread& thr,
+	bool direct) {
+	auto flags = O_RDONLY;
+	if (direct) {
+#ifdef O_DIRECT
+		flags |= O_DIRECT;
+#else
+		return -EOPNOTSUPP;
+#endif
+	}
+
+	// start read
+	auto fd = open(f.c_str(), flags);
+	if (fd < 0)
+		return -errno;
+	// size is unknown for entries typed by dirwalk
+	if (opt::read_pattern != ReadPattern::Seq && size < 0) {
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			auto ret = -errno;
+			close(fd);
+			return ret;
+		}
+		thr.get_mut_stat().inc_num_stat();
+		size = st.st_size;
+	}
+	auto ret = opt::read_pattern == ReadPattern::Seq ?
+		read_fd_seq(fd, thr, direct) :
+		read_fd_pattern(fd, size, thr, direct);
+	close(fd);
+	return ret;
+}
+
+int read_fd_seq(int fd, XThread& thr, bool direct) {
+	auto [buf, bufsiz] = thr.get_mut_dir().get_read_buffer();
+	auto resid = get_read_resid(bufsiz);
+	if (direct) {
+		assert(reinterpret_cast<uintptr_t>(buf) % get_page_size() == 0);
+		assert(bufsiz % get_page_size() == 0);
+	}
+
+	off_t off = 0;
+	while (1) {
+		// cut read size if > positive residual
+		auto n = bufsiz;
+		if (resid > 0)
+			if (n > static_cast<size_t>(resid))
+				n = resid;
+		// O_DIRECT requires aligned size, only count residual
+		if (direct)
+			n = (n + get_page_size() - 1) & ~(get_page_size() - 1);
+
+		auto siz = pread(fd, buf, n, off);
+		if (siz < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		auto eof = static_cast<size_t>(siz) < n;
+		if (resid > 0 && siz > resid)
+			siz = resid;
+		thr.get_mut_stat().inc_num_read();
+		thr.get_mut_stat().add_num_read_bytes(siz);
+		if (siz == 0)
+			break;
+		off += siz;
+
+		// end if positive residual becomes <= 0
+		if (resid > 0) {
+			resid -= siz;
+			if (resid <= 0) {
+				if (opt::debug)
+					assert(resid == 0);
+				break;
+			}
+		}
+		// O_DIRECT can't continue from unaligned offset
+		if (direct && eof)
+			break;
+	}
+	return 0;
+}
+
+// read read_ops blocks of read_block_size at block aligned offsets,
+// file size is from the stat of the entry
+int read_fd_pattern(int fd, off_t size, XThread& thr,
+	[[maybe_unused]] bool direct) {
+	auto [buf, bufsiz] = thr.get_mut_dir().get_read_buffer();
+	const auto bs = opt::read_block_size ? opt::read_block_size : bufsiz;
+	assert(bs <= bufsiz);
+	if (direct)
+		assert(bs % get_page_size() == 0);
+
+	auto nblk = (static_cast<unsigned long>(size) + bs - 1) / bs;
+	if (nblk == 0)
+		nblk = 1; // read 0 bytes at offset 0
+	auto stride = nblk / opt::read_ops;
+	if (stride == 0)
+		stride = 1;
+
+	for (unsigned long i = 0; i < opt::read_ops; i++) {
+		unsigned long blk;
+		if (opt::read_pattern == ReadPattern::Random)
+			blk = get_random<unsigned long>(0, nblk);
+		else
+			blk = (i * stride) % nblk; // strided
+		auto siz = pread(fd, buf, bs, static_cast<off_t>(blk * bs));
+		if (siz < 0) {
+			if (errno == EINTR) {
+				i--;
+				continue;
+			}
+			return -errno;
+		}
+		thr.get_mut_stat().inc_num_read();
+		thr.get_mut_stat().add_num_read_bytes(siz);
+	}
+	return 0;
+}
+
+int get_madvise_advice(void) {
+	switch (opt::madvise) {
+	case Madvise::Normal:
+		return MADV_NORMAL;
+	case Madvise::Sequential:
+		return MADV_SEQUENTIAL;
+	case Madvise::Random:
+		return MADV_RANDOM;
+	case Madvise::Willneed:
+		return MADV_WILLNEED;
+	case Madvise::Hugepage:
+#ifdef MADV_HUGEPAGE
+		return MADV_HUGEPAGE;
+#else
+		break;
+#endif
+	}
+	return MADV_NORMAL;
+}
+
+int read_file_mmap(const std::string& f, XThread& thr) {
+	auto bufsiz = opt::read_buffer_size;
+	auto resid = get_read_resid(bufsiz);
+
+	auto fd = open(f.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		auto error = errno;
+		close(fd);
+		return -error;
+	}
+	auto len = static_cast<size_t>(st.st_size);
+	if (resid > 0 && len > static_cast<size_t>(resid))
+		len = resid;
+	// nothing to map, count as a read hitting EOF
+	if (len == 0) {
+		close(fd);
+		thr.get_mut_stat().inc_num_read();
+		return 0;
+	}
+
+	auto p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+	auto error = errno;
+	close(fd); // mapping keeps the file
+	if (p == MAP_FAILED)
+		return -error;
+	// advice is only a hint, ignore failure
+	if (opt::madvise != Madvise::Normal)
+		madvise(p, len, get_madvise_advice());
+
+	// touch each page once, read_buffer_size bytes per read
+	const auto* data = static_cast<const volatile char*>(p);
+	const auto pgsiz = get_page_size();
+	size_t off = 0;
+	size_t pgoff = 0;
+	while (off < len) {
+		auto n = bufsiz;
+		if (n > len - off)
+			n = len - off;
+		for (; pgoff < off + n; pgoff += pgsiz)
+			data[pgoff];
+		off += n;
+		thr.get_mut_stat().inc_num_read();
+		thr.get_mut_stat().add_num_read_bytes(n);
+	}
+
+	munmap(p, len);
+	return 0;
+}
+
+#ifdef __linux__
+// move file data to /dev/null without copying to userspace
+int read_file_splice(const std::string& f, XThread& thr, bool sendfile) {
+	const auto bufsiz = opt::read_buffer_size;
+	auto resid = get_read_resid(bufsiz);
+	const auto null_fd = thr.get_dir().get_null_fd();
+	const auto [pipe_rfd, pipe_wfd] = thr.get_dir().get_pipe_fd();
+
+	auto fd = open(f.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	off_t off = 0;
+	auto ret = 0;
+	while (1) {
+		// cut read size if > positive residual
+		auto n = bufsiz;
+		if (resid > 0)
+			if (n > static_cast<size_t>(resid))
+				n = resid;
+
+		ssize_t siz;
+		if (sendfile)
+			siz = ::sendfile(null_fd, fd, &off, n);
+		else
+			siz = splice(fd, &off, pipe_wfd, nullptr, n,
+				SPLICE_F_MOVE);
+		if (siz < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+		// drain pipe
+		for (auto x = siz; !sendfile && x > 0;) {
+			auto y = splice(pipe_rfd, nullptr, null_fd, nullptr, x,
+				SPLICE_F_MOVE);
+			if (y < 0) {
+				if (errno == EINTR)
+					continue;
+				ret = -errno;
+				break;
+			}
+			x -= y;
+		}
+		if (ret < 0)
+			break;
+		thr.get_mut_stat().inc_num_read();
+		thr.get_mut_stat().add_num_read_bytes(siz);
+		if (siz == 0)
+			break;
+
+		// end if positive residual becomes <= 0
+		if (resid > 0) {
+			resid -= siz;
+			if (resid <= 0) {
+				if (opt::debug)
+					assert(resid == 0);
+				break;
+			}
+		}
+	}
+
+	close(fd);
+	return ret;
+}
+#else
+int read_file_splice([[maybe_unused]] const std::string& f,
+	[[maybe_unused]] XThread& thr, [[maybe_unused]] bool sendfile) {
+	return -EOPNOTSUPP;
+}
+#endif
 } // namespace
 
 int write_entry(const std::string& f, XThread& thr, const Dir& dir) {
@@ -211,11 +603,16 @@ int write_entry(const std::string& f, XThread& thr, const Dir& dir) {
 	if (opt::ignore_dot && t != FileType::Dir && is_dot_path(f))
 		return 0;
 
+	// path manipulation is lexical, f is absolute without trailing /
 	switch (t) {
 	case FileType::Dir:
-		return write_file(f, f, thr, dir);
+		if (opt::write_target != WriteTarget::New)
+			return 0;
+		return write_file(f, f, t, thr, dir);
 	case FileType::Reg:
-		return write_file(get_dirpath(f), f, thr, dir);
+		if (opt::write_target != WriteTarget::New)
+			return update_file(f, thr);
+		return write_file(get_dirpath(f, true), f, t, thr, dir);
 	case FileType::Device:
 		[[fallthrough]];
 	case FileType::Symlink:
@@ -227,8 +624,33 @@ int write_entry(const std::string& f, XThread& thr, const Dir& dir) {
 }
 
 namespace {
-int write_file(const std::string& d, const std::string& f, XThread& thr,
-	const Dir& dir) {
+long get_write_resid(size_t bufsiz) {
+	// file size is independent of buffer size
+	if (!opt::write_file_size.empty())
+		return opt::write_file_size.sample(get_random_engine());
+
+	auto resid = opt::write_size; // negative resid means no write
+	if (resid == 0) {
+		resid = get_random<long>(0, bufsiz) + 1;
+		assert(resid > 0);
+		assert(resid <= static_cast<long>(bufsiz));
+	}
+	assert(resid == -1 || resid > 0);
+	return resid;
+}
+
+bool is_sync_batch(void) {
+	return opt::sync_batch > 0 || opt::sync_batch_ms > 0;
+}
+
+bool is_fd_write_engine(void) {
+	return opt::write_engine == WriteEngine::Psync ||
+		opt::write_engine == WriteEngine::Direct ||
+		opt::write_engine == WriteEngine::Dsync;
+}
+
+int write_file(const std::string& d, const std::string& f, FileType ft,
+	XThread& thr, const Dir& dir) {
 	if (thr.is_write_done())
 		return 0;
 
@@ -240,56 +662,53 @@ int write_file(const std::string& d, const std::string& f, XThread& thr,
 		<< thr.get_dir().get_write_paths_counter();
 	auto newb = ss.str();
 	thr.get_mut_dir().inc_write_paths_counter();
-	auto newf = join_path(d, newb);
+	auto newf = join_path(d, newb, true);
 
 	// create an inode
 	auto i = get_random<int>(0,
 		static_cast<int>(opt::write_paths_type.size()));
 	auto t = opt::write_paths_type[i];
-	auto ret = create_inode(f, newf, t);
+	auto ret = check_sync_batch(thr);
+	if (ret < 0)
+		return ret;
+	if (t == WritePathsType::Reg && is_fd_write_engine())
+		return write_file_psync(d, newf, thr);
+	ret = create_inode(f, ft, newf, t);
 	if (ret < 0)
 		return ret;
-	if (opt::fsync_write_paths) {
-		auto ret = fsync_inode(newf);
-		if (ret < 0)
-			return ret;
-	}
-	if (opt::dirsync_write_paths) {
-		auto ret = fsync_inode(d);
-		if (ret < 0)
-			return ret;
-	}
 
-	// register the write path, and return unless regular file
+	// register the write path, and return unless regular file,
+	// regular file is synced after its data is written
 	thr.get_mut_dir().push_write_paths(newf);
 	if (t != WritePathsType::Reg) {
 		thr.get_mut_stat().inc_num_write();
-		return 0;
+		return sync_write_path(thr, newf, -1, d);
 	}
 
 	auto [buf, bufsiz] = thr.get_mut_dir().get_write_buffer();
-	auto resid = opt::write_size; // negative resid means no write
+	auto resid = get_write_resid(bufsiz);
 	if (resid < 0) {
 		thr.get_mut_stat().inc_num_write();
-		return 0;
-	} else if (resid == 0) {
-		resid = get_random<long>(0, bufsiz) + 1;
-		assert(resid > 0);
-		assert(resid <= static_cast<long>(bufsiz));
+		return sync_write_path(thr, newf, -1, d);
 	}
-	assert(resid > 0);
 
 	// path based truncate unlinke Rust or Go
 	if (opt::truncate_write_paths) {
 		std::filesystem::resize_file(newf, resid);
 		thr.get_mut_stat().inc_num_write();
-		if (opt::fsync_write_paths) {
-			auto ret = fsync_inode(newf);
-			if (ret < 0)
-				return ret;
-		}
-		return 0;
+		return sync_write_path(thr, newf, -1, d);
+	}
+
+#ifdef CONFIG_IO_URING
+	// io_uring fsync(2)s the file after write, no batch with io_uring
+	if (opt::write_engine == WriteEngine::Uring) {
+		ret = sync_write_dir(thr, d);
+		if (ret < 0)
+			return ret;
+		return thr.get_mut_dir().get_uring()->write_file(newf, resid,
+			thr, dir);
 	}
+#endif
 
 	// start write
 	std::ofstream ofs;
@@ -301,13 +720,8 @@ int write_file(const std::string& d, const std::string& f, XThread& thr,
 		auto n = static_cast<std::streamsize>(bufsiz);
 		if (n > resid)
 			n = resid;
-		if (opt::random_write_data) {
-			auto rbuf = dir.get_random_write_data();
-			auto i = get_random<int>(0, static_cast<int>(bufsiz));
-			memcpy(buf, rbuf + i, bufsiz);
-		}
-
 		auto pos = ofs.tellp();
+		fill_write_buffer(buf, n, static_cast<off_t>(pos));
 		ofs.write(buf, n);
 		auto siz = ofs.tellp() - pos;
 		assert(siz >= 0);
@@ -323,21 +737,298 @@ int write_file(const std::string& d, const std::string& f, XThread& thr,
 		}
 	}
 
-	if (opt::fsync_write_paths)
-		ofs.flush(); // not fsync
+	// data is flushed to the file before fsync(2)
+	ofs.close();
+	return sync_write_path(thr, newf, -1, d);
+}
+
+// adds open(2) flags of fd based write engine
+int get_write_flags(int flags) {
+	if (opt::write_engine == WriteEngine::Direct) {
+#ifdef O_DIRECT
+		flags |= O_DIRECT;
+#else
+		return -EOPNOTSUPP;
+#endif
+	} else if (opt::write_engine == WriteEngine::Dsync) {
+		flags |= O_DSYNC;
+	}
+	return flags;
+}
+
+// creates, writes and syncs a regular file via a single fd
+int write_file_psync(const std::string& d, const std::string& newf,
+	XThread& thr) {
+	auto direct = opt::write_engine == WriteEngine::Direct;
+	auto flags = get_write_flags(O_WRONLY | O_CREAT | O_TRUNC);
+	if (flags < 0)
+		return flags;
+
+	auto fd = open(newf.c_str(), flags, 0644);
+	if (fd < 0)
+		return -errno;
+	// register the write path, unlinked even if write fails
+	thr.get_mut_dir().push_write_paths(newf);
+
+	auto ret = write_fd(fd, thr, direct);
+	if (ret < 0) {
+		close(fd);
+		return ret;
+	}
+	return sync_write_path(thr, newf, fd, d);
+}
+
+int write_fd(int fd, XThread& thr, bool direct) {
+	auto [buf, bufsiz] = thr.get_mut_dir().get_write_buffer();
+	auto resid = get_write_resid(bufsiz);
+	if (resid < 0) {
+		thr.get_mut_stat().inc_num_write();
+		return 0;
+	}
+	if (direct) {
+		assert(reinterpret_cast<uintptr_t>(buf) % get_page_size() == 0);
+		assert(bufsiz % get_page_size() == 0);
+	}
+
+	auto ret = allocate_fd(fd, resid);
+	if (ret < 0)
+		return ret;
+
+	if (opt::truncate_write_paths) {
+		if (ftruncate(fd, resid) < 0)
+			return -errno;
+		thr.get_mut_stat().inc_num_write();
+		return deallocate_fd(fd, resid);
+	}
+
+	off_t off = 0;
+	ret = write_fd_data(fd, resid, off, thr, direct, false);
+	if (ret < 0)
+		return ret;
+
+	// drop padding of the last O_DIRECT write
+	if (direct && ftruncate(fd, off) < 0)
+		return -errno;
+	return deallocate_fd(fd, off);
+}
+
+// overwrites or appends to an existing regular file via a single fd,
+// only write paths kept by previous runs are modified
+int update_file(const std::string& f, XThread& thr) {
+	if (thr.is_write_done())
+		return 0;
+	if (!get_basename(f, true).starts_with(get_write_paths_base()))
+		return 0;
+	auto ret = check_sync_batch(thr);
+	if (ret < 0)
+		return ret;
+
+	auto direct = opt::write_engine == WriteEngine::Direct;
+	auto append = opt::write_target == WriteTarget::Append;
+	auto flags = get_write_flags(append ? O_WRONLY | O_APPEND : O_WRONLY);
+	if (flags < 0)
+		return flags;
+
+	auto fd = open(f.c_str(), flags);
+	if (fd < 0)
+		return -errno;
+	auto bufsiz = std::get<1>(thr.get_mut_dir().get_write_buffer());
+	auto resid = get_write_resid(bufsiz);
+	off_t off = 0;
+	if (resid > 0 && !append) {
+		// overwrite in place from a random page aligned offset,
+		// O_DIRECT overwrites whole pages within file
+		struct stat st;
+		const auto pgsiz = static_cast<off_t>(get_page_size());
+		if (fstat(fd, &st) < 0) {
+			ret = -errno;
+			close(fd);
+			return ret;
+		}
+		if (resid > st.st_size)
+			resid = st.st_size;
+		if (direct)
+			resid &= ~(pgsiz - 1);
+		// empty file (or < page for O_DIRECT) isn't overwritten
+		if (resid == 0) {
+			close(fd);
+			return 0;
+		}
+		off = get_random<off_t>(0,
+			(st.st_size - resid) / pgsiz + 1) * pgsiz;
+	} else if (resid > 0) {
+		// write data blocks are laid out from current end of file
+		off = lseek(fd, 0, SEEK_END);
+		if (off < 0) {
+			ret = -errno;
+			close(fd);
+			return ret;
+		}
+	}
+	if (resid < 0)
+		thr.get_mut_stat().inc_num_write();
+	else
+		ret = write_fd_data(fd, resid, off, thr, direct, append);
+	if (ret < 0) {
+		close(fd);
+		return ret;
+	}
+	thr.get_mut_dir().inc_num_update_paths();
+	return sync_write_path(thr, f, fd, "");
+}
+
+// writes residual bytes from offset which is advanced,
+// pwrite(2) ignores offset with O_APPEND on Linux so use write(2)
+int write_fd_data(int fd, long resid, off_t& off, XThread& thr, bool direct,
+	bool append) {
+	auto [buf, bufsiz] = thr.get_mut_dir().get_write_buffer();
+	assert(resid > 0);
+	while (1) {
+		// cut write size if > residual
+		auto n = bufsiz;
+		if (n > static_cast<size_t>(resid))
+			n = resid;
+		fill_write_buffer(buf, n, off);
+		// O_DIRECT requires aligned size, padding is left to caller
+		auto m = n;
+		if (direct)
+			m = (m + get_page_size() - 1) & ~(get_page_size() - 1);
+
+		auto siz = append ? write(fd, buf, m) : pwrite(fd, buf, m, off);
+		if (siz < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (siz > resid)
+			siz = resid;
+		thr.get_mut_stat().inc_num_write();
+		thr.get_mut_stat().add_num_write_bytes(siz);
+		off += siz;
+
+		// end if residual becomes <= 0
+		resid -= siz;
+		if (resid <= 0) {
+			if (opt::debug)
+				assert(resid == 0);
+			break;
+		}
+	}
 	return 0;
 }
 
+// allocates extents of a new file before data is written
+int allocate_fd([[maybe_unused]] int fd, [[maybe_unused]] off_t size) {
+#ifdef __linux__
+	auto mode = -1;
+	if (opt::write_alloc == WriteAlloc::Fallocate)
+		mode = 0;
+	else if (opt::write_alloc == WriteAlloc::ZeroRange)
+		mode = FALLOC_FL_ZERO_RANGE;
+	if (mode == -1)
+		return 0;
+	if (fallocate(fd, mode, 0, size) < 0)
+		return -errno;
+#endif
+	return 0;
+}
+
+// deallocates every other page of written data,
+// punch_hole keeps file size whereas collapse shifts the rest of file
+int deallocate_fd([[maybe_unused]] int fd, [[maybe_unused]] off_t size) {
+#ifdef __linux__
+	const auto pgsiz = static_cast<off_t>(get_page_size());
+	if (opt::write_alloc == WriteAlloc::PunchHole) {
+		for (auto off = pgsiz; off < size; off += pgsiz * 2)
+			if (fallocate(fd, FALLOC_FL_PUNCH_HOLE |
+				FALLOC_FL_KEEP_SIZE, off, pgsiz) < 0)
+				return -errno;
+	} else if (opt::write_alloc == WriteAlloc::Collapse) {
+		// collapsed range must end before EOF, go backward so that
+		// offsets of remaining ranges don't change
+		if (size <= 0)
+			return 0;
+		auto last = (size - 1) / pgsiz - 1;
+		for (auto i = last % 2 ? last : last - 1; i > 0; i -= 2)
+			if (fallocate(fd, FALLOC_FL_COLLAPSE_RANGE,
+				i * pgsiz, pgsiz) < 0)
+				return -errno;
+	}
+#endif
+	return 0;
+}
+} // namespace
+
+// regenerates write data of a chunk at file offset unless it's constant,
+// blocks are laid out by file offset so that partial chunks line up,
+// compressed blocks are partly random and otherwise zero,
+// deduplicated blocks are copies of a block common to all threads and runs
+void fill_write_buffer(char* buf, size_t siz, off_t off) {
+	if (opt::write_data == WriteData::Zero ||
+		opt::write_data == WriteData::Pattern)
+		return;
+
+	auto& e = get_random_engine();
+	RandomFiller r(e);
+	if (opt::write_data == WriteData::Random) {
+		r.fill(buf, siz);
+		return;
+	}
+
+	static const auto dedup_block = []() {
+		std::vector<char> v(WRITE_DATA_BLOCK_SIZE);
+		Xoshiro256pp e(0);
+		RandomFiller(e).fill(v.data(), v.size());
+		return v;
+	}();
+	std::uniform_real_distribution<double> coin(0, 100);
+	const auto bs = WRITE_DATA_BLOCK_SIZE;
+	const auto rlen = static_cast<size_t>(
+		static_cast<double>(bs) / opt::write_data_compress);
+
+	assert(off >= 0);
+	size_t i = 0;
+	while (i < siz) {
+		// [j, j + n) within a file block
+		auto j = static_cast<size_t>(off + static_cast<off_t>(i)) % bs;
+		auto n = std::min(bs - j, siz - i);
+		if (opt::write_data == WriteData::Compress) {
+			// buffer is reused, so clear the rest of block
+			auto m = j < rlen ? std::min(rlen - j, n) : 0;
+			r.fill(buf + i, m);
+			memset(buf + i + m, 0, n - m);
+		} else if (coin(e) < opt::write_data_dedup) {
+			memcpy(buf + i, dedup_block.data() + j, n);
+		} else {
+			r.fill(buf + i, n);
+		}
+		i += n;
+	}
+}
+
+int flush_entry(XThread& thr) {
+	auto ret = commit_sync_batch(thr);
+	if (ret < 0)
+		return ret;
+#ifdef CONFIG_IO_URING
+	auto uring = thr.get_mut_dir().get_uring();
+	if (uring)
+		return uring->flush(thr);
+#endif
+	return 0;
+}
+
+namespace {
 void create_regular_file(const std::string& f) {
 	std::ofstream ofs;
 	ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
 	ofs.open(f);
 }
 
-int create_inode(const std::string& oldf, const std::string& newf,
-	WritePathsType t) {
+int create_inode(const std::string& oldf, FileType oldt,
+	const std::string& newf, WritePathsType t) {
 	if (t == WritePathsType::Link) {
-		if (get_raw_file_type(oldf) == FileType::Reg) {
+		if (oldt == FileType::Reg) {
 			std::filesystem::create_hard_link(oldf, newf);
 			return 0;
 		}
@@ -375,6 +1066,158 @@ int fsync_inode(const std::string& f) {
 	return 0;
 }
 
+// times a durability operation of the class
+template <class F> int sync_timed(XThread& thr, SyncClass c, F fn) {
+	auto t = std::chrono::steady_clock::now();
+	auto ret = fn();
+	thr.get_mut_stat().add_sync_latency(c,
+		std::chrono::steady_clock::now() - t);
+	return ret;
+}
+
+int fsync_fd(int fd) {
+	return fsync(fd) < 0 ? -errno : 0;
+}
+
+// makes a write path and its parent directory durable unless batched,
+// fd is closed
+int sync_write_path(XThread& thr, const std::string& f, int fd,
+	const std::string& d) {
+	if (is_sync_batch()) {
+		// don't count write paths with nothing to sync
+		auto& b = thr.get_mut_dir().get_sync_batch();
+		auto dirsync = opt::dirsync_write_paths && !d.empty();
+		if (opt::fsync_write_paths || dirsync) {
+			if (b.count++ == 0)
+				b.time_begin = std::chrono::steady_clock::now();
+		}
+		if (opt::fsync_write_paths) {
+#ifdef __linux__
+			// start write-behind, waited on commit
+			if (opt::sync_method == SyncMethod::Writebehind &&
+				fd != -1)
+				sync_file_range(fd, 0, 0,
+					SYNC_FILE_RANGE_WRITE);
+#endif
+			b.files.push_back(f);
+		}
+		if (fd != -1)
+			close(fd);
+		if (dirsync)
+			b.dirs.insert(d);
+		return 0;
+	}
+
+	auto ret = 0;
+	if (opt::fsync_write_paths)
+		ret = sync_timed(thr, SyncClass::File, [&]() {
+			return fd != -1 ? fsync_fd(fd) : fsync_inode(f);
+		});
+	if (fd != -1)
+		close(fd);
+	if (ret < 0)
+		return ret;
+	return sync_write_dir(thr, d);
+}
+
+// makes a parent directory of a write path durable, never batched
+int sync_write_dir(XThread& thr, const std::string& d) {
+	if (!opt::dirsync_write_paths || d.empty())
+		return 0;
+	return sync_timed(thr, SyncClass::Dir, [&]() {
+		return fsync_inode(d);
+	});
+}
+
+// waits for write-behind started by sync_write_path(),
+// sync_file_range(2) persists neither metadata nor device cache,
+// so fdatasync(2) is what makes it durable
+int wait_write_behind(const std::string& f) {
+#ifdef __linux__
+	auto fd = open(f.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	auto ret = 0;
+	if (sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE |
+		SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) < 0 ||
+		fdatasync(fd) < 0)
+		ret = -errno;
+	close(fd);
+	return ret;
+#else
+	return fsync_inode(f);
+#endif
+}
+
+// commits the batch before a new write path if full or expired
+int check_sync_batch(XThread& thr) {
+	if (!is_sync_batch())
+		return 0;
+	const auto& b = thr.get_mut_dir().get_sync_batch();
+	if (b.count == 0)
+		return 0;
+	if (opt::sync_batch > 0 && b.count >= opt::sync_batch)
+		return commit_sync_batch(thr);
+	if (opt::sync_batch_ms > 0) {
+		auto d = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - b.time_begin);
+		if (static_cast<unsigned long>(d.count()) >=
+			opt::sync_batch_ms)
+			return commit_sync_batch(thr);
+	}
+	return 0;
+}
+
+// each parent directory is synced once per batch,
+// syncfs(2) makes everything durable with a single call
+int commit_sync_batch(XThread& thr) {
+	auto& b = thr.get_mut_dir().get_sync_batch();
+	if (b.count == 0)
+		return 0;
+
+	auto ret = sync_timed(thr, SyncClass::Batch, [&]() {
+		auto ret = 0;
+		if (opt::sync_method == SyncMethod::Syncfs) {
+#ifdef __linux__
+			// file system of write paths in the batch
+			assert(!b.files.empty() || !b.dirs.empty());
+			const auto& f = b.files.empty() ? *b.dirs.begin() :
+				b.files[0];
+			auto fd = open(f.c_str(), O_RDONLY);
+			if (fd < 0)
+				return -errno;
+			if (syncfs(fd) < 0)
+				ret = -errno;
+			close(fd);
+#endif
+			return ret;
+		}
+		for (const auto& f : b.files) {
+			auto r = sync_timed(thr, SyncClass::File, [&]() {
+				if (opt::sync_method ==
+					SyncMethod::Writebehind)
+					return wait_write_behind(f);
+				return fsync_inode(f);
+			});
+			if (r < 0 && ret == 0)
+				ret = r;
+		}
+		for (const auto& d : b.dirs) {
+			auto r = sync_timed(thr, SyncClass::Dir, [&]() {
+				return fsync_inode(d);
+			});
+			if (r < 0 && ret == 0)
+				ret = r;
+		}
+		return ret;
+	});
+
+	b.files.clear();
+	b.dirs.clear();
+	b.count = 0;
+	return ret;
+}
+
 std::string get_write_paths_base(void) {
 	std::ostringstream ss;
 	ss << WRITE_PATHS_PREFIX << "_" << opt::write_paths_base;
@@ -382,26 +1225,111 @@ std::string get_write_paths_base(void) {
 }
 } // namespace
 
-std::vector<std::string>
-collect_write_paths(const std::vector<std::string>& input) {
-	const auto b = get_write_paths_base();
-	std::vector<std::string> l;
-	for (const auto& f : remove_dup_string(input))
-		for (const auto& e : std::filesystem::recursive_directory_iterator(f)) {
-			auto x = e.path();
-			switch (get_raw_file_type(x)) {
-			case FileType::Dir:
-				[[fallthrough]];
-			case FileType::Reg:
-				[[fallthrough]];
-			case FileType::Symlink:
-				// don't resolve symlink (test symlink itself, not target)
-				if (get_basename(x, true).starts_with(b))
-					l.push_back(x);
-				break;
-			default:
-				break;
-			}
-		}
-	return l;
+// regular files and symlinks are unlinked while scanning,
+// directories are unlinked after that
+int clean_write_paths(const std::vector<std::string>& input,
+	std::vector<std::string>& l, UnlinkStat& us) {
+	auto t = std::chrono::steady_clock::now();
+	unsigned long n = 0;
+	auto ret = scan_unlink(remove_dup_string(input),
+		get_write_paths_base(), opt::num_scanner, l, n);
+	if (ret < 0)
+		return ret;
+	std::chrono::duration<double> d = std::chrono::steady_clock::now() - t;
+	us.num_unlinked += n;
+	us.sec += d.count();
+	std::cout << "Unlinked " << n << " write paths while scanning"
+		<< std::endl;
+	return unlink_write_paths(l, -1, opt::num_scanner, us);
+}
+
+#ifdef CONFIG_CPPUNIT
+#include <cppunit/TestAssert.h>
+
+#include "./cppunit.h"
+#include "./walk.h"
+
+void DirTest::test_read_flist_entry(void) {
+	if (!is_linux())
+		return;
+
+	auto d = join_path("/tmp", "dirload_dir_test_" + get_time_string());
+	std::filesystem::create_directories(d);
+	for (const auto& x : {"x", "y", "z"})
+		std::ofstream(join_path(d, x)) << x;
+	auto f = d + ".flist";
+	CPPUNIT_ASSERT_EQUAL(create_flist_file({d}, f, false, false, 1,
+		FlistFormat::Binary), 0);
+	MmapFlist fl(f);
+	CPPUNIT_ASSERT_EQUAL(fl.size(), 3lu);
+
+	const auto stat_only = opt::stat_only;
+	const auto flist_cached_stat = opt::flist_cached_stat;
+	std::string buf;
+	// {stat_only, flist_cached_stat, stats per entry}
+	for (const auto& [x, y, n] : std::vector<std::tuple<bool, bool,
+		unsigned long>>{{true, false, 1}, {true, true, 1},
+		{false, false, 1}, {false, true, 0}}) {
+		opt::stat_only = x;
+		opt::flist_cached_stat = y;
+		auto thr = XThread::newread(0, 4096);
+		for (size_t i = 0; i < fl.size(); i++)
+			CPPUNIT_ASSERT_EQUAL(read_flist_entry(std::string(
+				fl.get(i, buf)), fl, i, *thr), 0);
+		CPPUNIT_ASSERT_EQUAL(thr->get_stat().get_num_stat(),
+			n * fl.size());
+	}
+
+	// removed entry is skipped
+	opt::stat_only = false;
+	opt::flist_cached_stat = false;
+	std::filesystem::remove(join_path(d, "x"));
+	auto thr = XThread::newread(0, 4096);
+	CPPUNIT_ASSERT_EQUAL(read_flist_entry(join_path(d, "x"), fl, 0, *thr),
+		0);
+	CPPUNIT_ASSERT_EQUAL(thr->get_stat().get_num_stat(), 1lu);
+	opt::stat_only = stat_only;
+	opt::flist_cached_stat = flist_cached_stat;
+	std::filesystem::remove_all(d);
+	std::filesystem::remove(f);
 }
+
+void DirTest::test_read_walk_entry(void) {
+	if (!is_linux())
+		return;
+
+	auto d = join_path("/tmp", "dirload_dir_test_" + get_time_string());
+	std::filesystem::create_directories(join_path(d, "a"));
+	std::ofstream(join_path(d, "x")) << "x";
+
+	const auto stat_only = opt::stat_only;
+	// {stat_only, stats per entry}
+	for (const auto& [x, n] : std::vector<std::tuple<bool,
+		unsigned long>>{{true, 1}, {false, 0}}) {
+		opt::stat_only = x;
+		auto thr = XThread::newread(0, 4096);
+		unsigned long count = 0;
+		CPPUNIT_ASSERT_EQUAL(walk_dir(d, [&](const std::string& f,
+			FileType t) {
+			count++;
+			return read_walk_entry(f, t, *thr);
+		}), 0);
+		CPPUNIT_ASSERT_EQUAL(count, 2lu);
+		CPPUNIT_ASSERT_EQUAL(thr->get_stat().get_num_stat(),
+			n * count);
+	}
+
+	// removed entry is skipped
+	const auto read_engine = opt::read_engine;
+	opt::stat_only = false;
+	opt::read_engine = ReadEngine::Psync;
+	auto thr = XThread::newread(0, 4096);
+	CPPUNIT_ASSERT_EQUAL(read_walk_entry(join_path(d, "y"),
+		FileType::Reg, *thr), 0);
+	opt::stat_only = stat_only;
+	opt::read_engine = read_engine;
+	std::filesystem::remove_all(d);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DirTest);
+#endif
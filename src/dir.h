@@ -2,14 +2,36 @@
 #define SRC_DIR_H_
 
 #include <vector>
+#include <set>
 #include <tuple>
 #include <string>
+#include <memory>
+#include <chrono>
+
+#include "./stat.h"
+#include "./util.h"
 
 extern const unsigned long MAX_BUFFER_SIZE;
 
+class Flist;
+#ifdef CONFIG_IO_URING
+class UringEngine;
+#endif
+
+// write paths whose durability is deferred to the end of a batch,
+// no fd is held since RLIMIT_NOFILE is shared by all threads
+struct SyncBatch {
+	std::vector<std::string> files;
+	std::set<std::string> dirs;
+	unsigned long count;
+	std::chrono::steady_clock::time_point time_begin;
+};
+
 class ThreadDir {
 	public:
 	ThreadDir(unsigned long, unsigned long);
+	ThreadDir(ThreadDir&&);
+	~ThreadDir(void);
 	static ThreadDir newread(unsigned long bufsiz) {
 		return ThreadDir(bufsiz, 0);
 	}
@@ -24,6 +46,20 @@ class ThreadDir {
 		return {_write_buffer.data(), _write_buffer.size()};
 	}
 
+	// sink for zero-copy read engines
+	int get_null_fd(void) const {
+		return _null_fd;
+	}
+	std::tuple<int, int> get_pipe_fd(void) const {
+		return {_pipe_fd[0], _pipe_fd[1]};
+	}
+
+#ifdef CONFIG_IO_URING
+	UringEngine* get_uring(void) {
+		return _uring.get();
+	}
+#endif
+
 	unsigned long get_num_write_paths(void) const {
 		return _write_paths.size();
 	}
@@ -33,6 +69,17 @@ class ThreadDir {
 	void splice_write_paths(std::vector<std::string>& l) const {
 		l.insert(l.end(), _write_paths.begin(), _write_paths.end());
 	}
+	// existing files overwritten or appended to, not unlinked
+	unsigned long get_num_update_paths(void) const {
+		return _num_update_paths;
+	}
+	void inc_num_update_paths(void) {
+		_num_update_paths++;
+	}
+
+	SyncBatch& get_sync_batch(void) {
+		return _sync_batch;
+	}
 
 	unsigned long get_write_paths_counter(void) const {
 		return _write_paths_counter;
@@ -42,31 +89,58 @@ class ThreadDir {
 	}
 
 	private:
-	std::vector<char> _read_buffer;
-	std::vector<char> _write_buffer;
+	Buffer _read_buffer;
+	Buffer _write_buffer;
 	std::vector<std::string> _write_paths;
 	unsigned long _write_paths_counter;
+	unsigned long _num_update_paths;
+	SyncBatch _sync_batch;
+	int _null_fd;
+	int _pipe_fd[2];
+#ifdef CONFIG_IO_URING
+	std::unique_ptr<UringEngine> _uring;
+#endif
 };
 
 class Dir {
 	public:
-	explicit Dir(bool);
-	const unsigned char* get_random_write_data(void) const {
-		return _random_write_data.empty() ? NULL : _random_write_data.data();
-	}
+	Dir(void);
 	const std::string& get_write_paths_ts(void) const {
 		return _write_paths_ts;
 	}
 
 	private:
-	std::vector<unsigned char> _random_write_data;
 	std::string _write_paths_ts;
 };
 
-unsigned long cleanup_write_paths(const std::vector<const ThreadDir*>&);
-int unlink_write_paths(std::vector<std::string>&, long);
+int cleanup_write_paths(const std::vector<const ThreadDir*>&, unsigned long&,
+	UnlinkStat&);
 class XThread;
 int read_entry(const std::string&, XThread&);
+int read_entry_type(const std::string&, FileType, off_t, XThread&);
+int read_flist_entry(const std::string&, const Flist&, size_t, XThread&);
+int read_walk_entry(const std::string&, FileType, XThread&);
 int write_entry(const std::string&, XThread&, const Dir&);
-std::vector<std::string> collect_write_paths(const std::vector<std::string>&);
+int flush_entry(XThread&);
+void fill_write_buffer(char*, size_t, off_t);
+int clean_write_paths(const std::vector<std::string>&,
+	std::vector<std::string>&, UnlinkStat&);
+
+#ifdef CONFIG_CPPUNIT
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class DirTest: public CPPUNIT_NS::TestFixture {
+	public:
+	CPPUNIT_TEST_SUITE(DirTest);
+	CPPUNIT_TEST(test_read_flist_entry);
+	CPPUNIT_TEST(test_read_walk_entry);
+	CPPUNIT_TEST_SUITE_END();
+
+	private:
+	void test_read_flist_entry(void);
+	void test_read_walk_entry(void);
+};
+#endif
 #endif // SRC_DIR_H_
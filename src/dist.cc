@@ -0,0 +1,299 @@
+#include <sstream>
+#include <random>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include <cmath>
+#include <cassert>
+
+#include "./dist.h"
+
+AliasDist::AliasDist(const std::vector<double>& weights):
+	_prob(weights.size()),
+	_alias(weights.size()) {
+	auto n = weights.size();
+	assert(n > 0);
+	assert(n <= UINT32_MAX);
+
+	double sum = 0;
+	for (auto w : weights) {
+		assert(w >= 0);
+		sum += w;
+	}
+	assert(sum > 0);
+
+	// scale so that average is 1, then pair each small entry with
+	// a large one which donates the rest of the slot (Vose)
+	std::vector<double> p(n);
+	std::vector<uint32_t> small, large;
+	for (size_t i = 0; i < n; i++) {
+		p[i] = weights[i] * static_cast<double>(n) / sum;
+		if (p[i] < 1)
+			small.push_back(static_cast<uint32_t>(i));
+		else
+			large.push_back(static_cast<uint32_t>(i));
+	}
+	while (!small.empty() && !large.empty()) {
+		auto s = small.back();
+		small.pop_back();
+		auto l = large.back();
+		_prob[s] = static_cast<float>(p[s]);
+		_alias[s] = l;
+		p[l] -= 1 - p[s];
+		if (p[l] < 1) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// remaining ones are 1 except for rounding errors
+	for (auto i : large) {
+		_prob[i] = 1;
+		_alias[i] = i;
+	}
+	for (auto i : small) {
+		_prob[i] = 1;
+		_alias[i] = i;
+	}
+}
+
+size_t AliasDist::sample(Xoshiro256pp& e) const {
+	std::uniform_int_distribution<size_t> index(0, _prob.size() - 1);
+	std::uniform_real_distribution<float> coin(0, 1);
+	auto i = index(e);
+	return coin(e) < _prob[i] ? i : _alias[i];
+}
+
+HotspotDist::HotspotDist(size_t siz, double pct_files, double pct_ops):
+	_size(siz),
+	_hot(static_cast<size_t>(static_cast<double>(siz) * pct_files / 100)),
+	_ops(pct_ops / 100) {
+	assert(_size > 0);
+	if (_hot == 0)
+		_hot = 1;
+	if (_hot > _size)
+		_hot = _size;
+}
+
+size_t HotspotDist::sample(Xoshiro256pp& e) const {
+	std::uniform_real_distribution<double> coin(0, 1);
+	if (_hot == _size || coin(e) < _ops) {
+		std::uniform_int_distribution<size_t> hot(0, _hot - 1);
+		return hot(e);
+	} else {
+		std::uniform_int_distribution<size_t> cold(_hot, _size - 1);
+		return cold(e);
+	}
+}
+
+PermutedDist::PermutedDist(std::unique_ptr<const IndexDist> dist,
+	Xoshiro256pp& e):
+	_dist(std::move(dist)),
+	_perm(_dist->size()) {
+	std::iota(_perm.begin(), _perm.end(), 0);
+	std::shuffle(_perm.begin(), _perm.end(), e);
+}
+
+SizeDist::SizeDist(const std::string& arg):
+	_type(Type::Fixed),
+	_a(0),
+	_b(0) {
+	std::vector<std::string> v;
+	std::stringstream ss(arg);
+	std::string x;
+	while (std::getline(ss, x, ':'))
+		v.push_back(x);
+
+	if (v.size() == 1) {
+		_a = parse_size(v[0]);
+	} else if (v.size() == 3 && v[0] == "uniform") {
+		_type = Type::Uniform;
+		_a = parse_size(v[1]);
+		_b = parse_size(v[2]);
+		if (_a > _b)
+			throw std::invalid_argument(arg);
+	} else if (v.size() == 2 && v[0] == "exp") {
+		_type = Type::Exp;
+		_a = parse_size(v[1]);
+	} else {
+		throw std::invalid_argument(arg);
+	}
+	// 0 byte file is created without write
+	if (_a == 0 && _type != Type::Uniform)
+		throw std::invalid_argument(arg);
+}
+
+// returns > 0
+long SizeDist::sample(Xoshiro256pp& e) const {
+	long x = 0;
+	switch (_type) {
+	case Type::Fixed:
+		x = _a;
+		break;
+	case Type::Uniform: {
+		std::uniform_int_distribution<long> dist(_a, _b);
+		x = dist(e);
+		break;
+	}
+	case Type::Exp: {
+		std::exponential_distribution<double> dist(
+			1 / static_cast<double>(_a));
+		x = std::lround(dist(e));
+		break;
+	}
+	default:
+		assert(false);
+		break;
+	}
+	return x > 0 ? x : 1;
+}
+
+// weight of i-th entry is 1 / (i + 1)^theta, uniform if theta is 0
+std::vector<double> get_zipf_weights(size_t siz, double theta) {
+	assert(theta >= 0);
+	std::vector<double> v(siz);
+	for (size_t i = 0; i < siz; i++)
+		v[i] = 1 / std::pow(static_cast<double>(i + 1), theta);
+	return v;
+}
+
+// normal distribution centered in entries,
+// stddev is in percentage of number of entries
+std::vector<double> get_gaussian_weights(size_t siz, double pct_stddev) {
+	assert(pct_stddev > 0);
+	auto n = static_cast<double>(siz);
+	auto mean = n / 2;
+	auto stddev = n * pct_stddev / 100;
+	std::vector<double> v(siz);
+	for (size_t i = 0; i < siz; i++) {
+		auto x = (static_cast<double>(i) + 0.5 - mean) / stddev;
+		v[i] = std::exp(-0.5 * x * x);
+	}
+	return v;
+}
+
+#ifdef CONFIG_CPPUNIT
+void DistTest::test_alias_dist(void) {
+	Xoshiro256pp e(1);
+	AliasDist d({1, 0, 3, 0});
+	CPPUNIT_ASSERT_EQUAL(d.size(), 4lu);
+	std::vector<size_t> count(d.size());
+	for (auto i = 0; i < 40000; i++) {
+		auto x = d.sample(e);
+		CPPUNIT_ASSERT(x < d.size());
+		count[x]++;
+	}
+	CPPUNIT_ASSERT_EQUAL(count[1], 0lu);
+	CPPUNIT_ASSERT_EQUAL(count[3], 0lu);
+	CPPUNIT_ASSERT(count[0] > 9000 && count[0] < 11000);
+	CPPUNIT_ASSERT(count[2] > 29000 && count[2] < 31000);
+
+	AliasDist u({1});
+	for (auto i = 0; i < 100; i++)
+		CPPUNIT_ASSERT_EQUAL(u.sample(e), 0lu);
+}
+
+void DistTest::test_hotspot_dist(void) {
+	Xoshiro256pp e(1);
+	HotspotDist d(100, 20, 80);
+	CPPUNIT_ASSERT_EQUAL(d.size(), 100lu);
+	size_t hot = 0;
+	for (auto i = 0; i < 10000; i++) {
+		auto x = d.sample(e);
+		CPPUNIT_ASSERT(x < d.size());
+		if (x < 20)
+			hot++;
+	}
+	CPPUNIT_ASSERT(hot > 7500 && hot < 8500);
+
+	// at least one hot entry
+	HotspotDist h(10, 1, 100);
+	for (auto i = 0; i < 100; i++)
+		CPPUNIT_ASSERT_EQUAL(h.sample(e), 0lu);
+	HotspotDist a(10, 100, 0);
+	for (auto i = 0; i < 100; i++)
+		CPPUNIT_ASSERT(a.sample(e) < 10);
+}
+
+void DistTest::test_permuted_dist(void) {
+	Xoshiro256pp e(1);
+	PermutedDist d(std::make_unique<const HotspotDist>(100, 20, 100), e);
+	CPPUNIT_ASSERT_EQUAL(d.size(), 100lu);
+	std::vector<size_t> count(d.size());
+	for (auto i = 0; i < 10000; i++) {
+		auto x = d.sample(e);
+		CPPUNIT_ASSERT(x < d.size());
+		count[x]++;
+	}
+	// same number of hot entries, not a contiguous range
+	std::vector<size_t> hot;
+	for (size_t i = 0; i < count.size(); i++)
+		if (count[i])
+			hot.push_back(i);
+	CPPUNIT_ASSERT_EQUAL(hot.size(), 20lu);
+	CPPUNIT_ASSERT(hot.back() - hot.front() + 1 > hot.size());
+
+	// single hot entry lands on the same index with the same engine
+	Xoshiro256pp x(1), y(1), z(1);
+	PermutedDist a(std::make_unique<const HotspotDist>(100, 1, 100), x);
+	PermutedDist b(std::make_unique<const HotspotDist>(100, 1, 100), y);
+	CPPUNIT_ASSERT_EQUAL(a.sample(z), b.sample(z));
+}
+
+void DistTest::test_size_dist(void) {
+	Xoshiro256pp e(1);
+	CPPUNIT_ASSERT(SizeDist().empty());
+	SizeDist f("1G");
+	CPPUNIT_ASSERT(!f.empty());
+	CPPUNIT_ASSERT_EQUAL(f.sample(e), 1l << 30);
+
+	SizeDist u("uniform:4K:8K");
+	for (auto i = 0; i < 1000; i++) {
+		auto x = u.sample(e);
+		CPPUNIT_ASSERT(x >= 4096 && x <= 8192);
+	}
+
+	SizeDist x("exp:1M");
+	double sum = 0;
+	for (auto i = 0; i < 10000; i++) {
+		auto n = x.sample(e);
+		CPPUNIT_ASSERT(n > 0);
+		sum += static_cast<double>(n);
+	}
+	sum /= 10000;
+	CPPUNIT_ASSERT(sum > 0.9 * (1 << 20) && sum < 1.1 * (1 << 20));
+
+	for (const auto& s : {"", "0", "exp:0", "uniform:2K:1K", "uniform:1K",
+		"zipf:1K", "1Q"}) {
+		auto thrown = false;
+		try {
+			SizeDist d(s);
+		} catch (const std::exception& e) {
+			thrown = true;
+		}
+		CPPUNIT_ASSERT_MESSAGE(s, thrown);
+	}
+}
+
+void DistTest::test_get_zipf_weights(void) {
+	auto v = get_zipf_weights(4, 1);
+	CPPUNIT_ASSERT_EQUAL(v.size(), 4lu);
+	CPPUNIT_ASSERT_EQUAL(v[0], 1.0);
+	CPPUNIT_ASSERT_EQUAL(v[1], 0.5);
+	CPPUNIT_ASSERT_EQUAL(v[3], 0.25);
+	for (auto x : get_zipf_weights(4, 0))
+		CPPUNIT_ASSERT_EQUAL(x, 1.0);
+}
+
+void DistTest::test_get_gaussian_weights(void) {
+	auto v = get_gaussian_weights(10, 20);
+	CPPUNIT_ASSERT_EQUAL(v.size(), 10lu);
+	for (size_t i = 0; i < 5; i++)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(v[i], v[9 - i], 1e-12);
+	for (size_t i = 0; i < 4; i++)
+		CPPUNIT_ASSERT(v[i] < v[i + 1]);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DistTest);
+#endif
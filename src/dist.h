@@ -0,0 +1,124 @@
+#ifndef SRC_DIST_H_
+#define SRC_DIST_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include <cstdint>
+
+#include "./util.h"
+
+// samples an index in [0, size) for skewed path selection,
+// tables are built once and shared by threads, sampling is O(1)
+class IndexDist {
+	public:
+	virtual ~IndexDist(void) = default;
+	virtual size_t size(void) const = 0;
+	virtual size_t sample(Xoshiro256pp&) const = 0;
+};
+
+// Walker's alias method over arbitrary weights,
+// O(n) to build and one uniform index plus one coin flip to sample
+class AliasDist: public IndexDist {
+	public:
+	explicit AliasDist(const std::vector<double>&);
+	size_t size(void) const override {
+		return _prob.size();
+	}
+	size_t sample(Xoshiro256pp&) const override;
+
+	private:
+	std::vector<float> _prob; // probability of keeping the index
+	std::vector<uint32_t> _alias;
+};
+
+// pct_ops of operations go to the first pct_files of entries
+class HotspotDist: public IndexDist {
+	public:
+	HotspotDist(size_t, double, double);
+	size_t size(void) const override {
+		return _size;
+	}
+	size_t sample(Xoshiro256pp&) const override;
+
+	private:
+	size_t _size;
+	size_t _hot; // number of hot entries
+	double _ops; // ratio of operations to hot entries
+};
+
+// maps sampled ranks through a fixed random permutation of indices,
+// so that heavy entries aren't neighbors in a path sorted flist
+class PermutedDist: public IndexDist {
+	public:
+	PermutedDist(std::unique_ptr<const IndexDist>, Xoshiro256pp&);
+	size_t size(void) const override {
+		return _perm.size();
+	}
+	size_t sample(Xoshiro256pp& e) const override {
+		return _perm[_dist->sample(e)];
+	}
+
+	private:
+	std::unique_ptr<const IndexDist> _dist;
+	std::vector<size_t> _perm;
+};
+
+// file size of <size>, uniform:<min>:<max> or exp:<mean>,
+// sizes accept K, M, G and T suffixes
+class SizeDist {
+	public:
+	SizeDist(void):
+		_type(Type::None),
+		_a(0),
+		_b(0) {
+	}
+	explicit SizeDist(const std::string&);
+	bool empty(void) const {
+		return _type == Type::None;
+	}
+	long sample(Xoshiro256pp&) const;
+
+	private:
+	enum class Type {
+		None,
+		Fixed,
+		Uniform,
+		Exp,
+	};
+
+	Type _type;
+	long _a;
+	long _b;
+};
+
+std::vector<double> get_zipf_weights(size_t, double);
+std::vector<double> get_gaussian_weights(size_t, double);
+
+#ifdef CONFIG_CPPUNIT
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class DistTest: public CPPUNIT_NS::TestFixture {
+	public:
+	CPPUNIT_TEST_SUITE(DistTest);
+	CPPUNIT_TEST(test_alias_dist);
+	CPPUNIT_TEST(test_hotspot_dist);
+	CPPUNIT_TEST(test_permuted_dist);
+	CPPUNIT_TEST(test_size_dist);
+	CPPUNIT_TEST(test_get_zipf_weights);
+	CPPUNIT_TEST(test_get_gaussian_weights);
+	CPPUNIT_TEST_SUITE_END();
+
+	private:
+	void test_alias_dist(void);
+	void test_hotspot_dist(void);
+	void test_permuted_dist(void);
+	void test_size_dist(void);
+	void test_get_zipf_weights(void);
+	void test_get_gaussian_weights(void);
+};
+#endif
+#endif // SRC_DIST_H_
@@ -2,39 +2,357 @@
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <system_error>
+#include <tuple>
+
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "./flist.h"
+#include "./scan.h"
+#include "./thread.h"
 #include "./util.h"
 
-std::vector<std::string> init_flist(const std::string& input, bool ignore_dot) {
-	std::vector<std::string> l;
-	for (const auto& x : std::filesystem::recursive_directory_iterator(input)) {
-		auto f = x.path();
-		auto t = get_raw_file_type(f);
-		// ignore . entries if specified
-		if (ignore_dot && t != FileType::Dir && is_dot_path(f))
-			continue;
-		if (t == FileType::Reg || t == FileType::Symlink)
-			l.push_back(f);
+static_assert(sizeof(FlistHeader) == 48);
+static_assert(sizeof(FlistEntry) == 24);
+
+namespace {
+void put_varint(std::vector<char>& v, size_t x) {
+	while (x >= 0x80) {
+		v.push_back(static_cast<char>((x & 0x7f) | 0x80));
+		x >>= 7;
+	}
+	v.push_back(static_cast<char>(x));
+}
+
+size_t get_varint(const char*& p) {
+	size_t x = 0;
+	for (auto shift = 0; ; shift += 7) {
+		auto c = static_cast<unsigned char>(*p++);
+		x |= static_cast<size_t>(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return x;
+	}
+}
+
+typedef std::tuple<const Flist*, const PrefixMatcher*, size_t, size_t,
+	std::vector<std::vector<size_t>>*, size_t*> thread_assign_arg;
+
+// assigns [begin, end) of flist, unmatched is end unless failed
+void assign_flist_range(const Flist& fl, const PrefixMatcher& matcher,
+	size_t begin, size_t end, std::vector<std::vector<size_t>>& l,
+	size_t& unmatched) {
+	std::string buf;
+	unmatched = end;
+	for (auto j = begin; j < end; j++) {
+		auto n = matcher.match(fl.get(j, buf), [&](size_t i) {
+			l[i].push_back(j);
+		});
+		if (n == 0) {
+			unmatched = j;
+			return;
+		}
+	}
+}
+
+EXTERN_C_BEGIN
+void* assign_handler(void* arg) {
+	auto [fl, matcher, begin, end, l, unmatched] =
+		*reinterpret_cast<thread_assign_arg*>(arg);
+	assign_flist_range(*fl, *matcher, begin, end, *l, *unmatched);
+	return nullptr;
+}
+EXTERN_C_END
+
+int write_flist_file_text(const std::vector<ScanEntry>& fl,
+	const std::string& flist_file) {
+	std::ofstream ofs;
+	ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	ofs.open(flist_file);
+
+	for (const auto& x : fl)
+		ofs << x.path << std::endl;
+	ofs.flush();
+	return 0;
+}
+
+int write_flist_file_binary(const std::vector<ScanEntry>& fl,
+	const std::string& flist_file) {
+	FlistHeader h;
+	memcpy(h.magic, FLIST_MAGIC, sizeof(h.magic));
+	h.version = FLIST_VERSION;
+	h.flags = FLIST_FLAG_SORTED;
+	h.count = fl.size();
+	h.entry_off = sizeof(h);
+	h.blob_off = h.entry_off + h.count * sizeof(FlistEntry);
+	h.blob_size = 0;
+
+	std::vector<FlistEntry> ev;
+	ev.reserve(fl.size());
+	for (const auto& x : fl) {
+		if (x.path.size() > UINT32_MAX)
+			return -ENAMETOOLONG;
+		ev.push_back({h.blob_size, x.size,
+			static_cast<uint32_t>(x.path.size()),
+			static_cast<uint32_t>(x.type)});
+		h.blob_size += x.path.size() + 1;
 	}
-	return l;
+
+	std::ofstream ofs;
+	ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	ofs.open(flist_file, std::ios::binary);
+
+	ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	ofs.write(reinterpret_cast<const char*>(ev.data()),
+		static_cast<std::streamsize>(ev.size() * sizeof(FlistEntry)));
+	for (const auto& x : fl)
+		ofs.write(x.path.c_str(),
+			static_cast<std::streamsize>(x.path.size() + 1));
+	ofs.flush();
+	return 0;
+}
+} // namespace
+
+void FrontCodedFlist::push_back(std::string_view s) {
+	size_t lcp = 0;
+	if (_count % BLOCK_SIZE == 0) {
+		_blocks.push_back(_data.size());
+	} else {
+		auto n = std::min(s.size(), _last.size());
+		while (lcp < n && s[lcp] == _last[lcp])
+			lcp++;
+		put_varint(_data, lcp);
+	}
+	put_varint(_data, s.size() - lcp);
+	_data.insert(_data.end(), s.begin() + static_cast<long>(lcp), s.end());
+	_last.assign(s);
+	_count++;
+}
+
+void FrontCodedFlist::shrink_to_fit(void) {
+	_data.shrink_to_fit();
+	_blocks.shrink_to_fit();
+	std::string().swap(_last);
+}
+
+std::string_view FrontCodedFlist::get(size_t i, std::string& buf) const {
+	assert(i < _count);
+	const auto* p = _data.data() + _blocks[i / BLOCK_SIZE];
+	auto n = get_varint(p);
+	buf.assign(p, n);
+	p += n;
+	for (size_t j = 0; j < i % BLOCK_SIZE; j++) {
+		auto lcp = get_varint(p);
+		n = get_varint(p);
+		buf.resize(lcp);
+		buf.append(p, n);
+		p += n;
+	}
+	return buf;
+}
+
+MmapFlist::MmapFlist(const std::string& flist_file):
+	_map(MAP_FAILED),
+	_map_size(0),
+	_flags(0),
+	_count(0),
+	_entries(nullptr),
+	_blob(nullptr) {
+	auto fd = open(flist_file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(),
+			flist_file);
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		auto error = errno;
+		close(fd);
+		throw std::system_error(error, std::generic_category(),
+			flist_file);
+	}
+	_map_size = static_cast<size_t>(st.st_size);
+	if (_map_size < sizeof(FlistHeader)) {
+		close(fd);
+		throw std::system_error(EINVAL, std::generic_category(),
+			flist_file);
+	}
+	_map = mmap(nullptr, _map_size, PROT_READ, MAP_SHARED, fd, 0);
+	auto error = errno;
+	close(fd);
+	if (_map == MAP_FAILED)
+		throw std::system_error(error, std::generic_category(),
+			flist_file);
+
+	// validate header and entries before handing out paths
+	const auto p = static_cast<const char*>(_map);
+	const auto h = reinterpret_cast<const FlistHeader*>(p);
+	auto valid = !memcmp(h->magic, FLIST_MAGIC, sizeof(h->magic)) &&
+		h->version == FLIST_VERSION &&
+		h->entry_off % alignof(FlistEntry) == 0 &&
+		h->entry_off <= _map_size &&
+		h->count <= (_map_size - h->entry_off) / sizeof(FlistEntry) &&
+		h->blob_off <= _map_size &&
+		h->blob_size <= _map_size - h->blob_off;
+	if (valid) {
+		_flags = h->flags;
+		_count = h->count;
+		_entries = reinterpret_cast<const FlistEntry*>(p + h->entry_off);
+		_blob = p + h->blob_off;
+		for (size_t i = 0; i < _count && valid; i++) {
+			const auto& e = _entries[i];
+			valid = e.off < h->blob_size &&
+				e.len < h->blob_size - e.off &&
+				_blob[e.off + e.len] == '\0';
+		}
+	}
+	if (!valid) {
+		munmap(_map, _map_size);
+		throw std::system_error(EINVAL, std::generic_category(),
+			flist_file);
+	}
+	madvise(_map, _map_size, MADV_WILLNEED);
+}
+
+MmapFlist::~MmapFlist(void) {
+	if (_map != MAP_FAILED)
+		munmap(_map, _map_size);
+}
+
+PrefixMatcher::PrefixMatcher(const std::vector<std::string>& input):
+	_sorted{},
+	_index{},
+	_parent{} {
+	for (size_t i = 0; i < input.size(); i++)
+		_index.push_back(i);
+	std::sort(_index.begin(), _index.end(), [&](size_t a, size_t b) {
+		return input[a] < input[b];
+	});
+	for (auto i : _index)
+		_sorted.push_back(input[i]);
+	for (size_t k = 0; k < _sorted.size(); k++) {
+		auto i = static_cast<long>(k) - 1;
+		while (i >= 0 && !_sorted[k].starts_with(_sorted[i]))
+			i = _parent[i];
+		_parent.push_back(i);
+	}
+}
+
+bool is_binary_flist_file(const std::string& flist_file) {
+	std::ifstream ifs(flist_file, std::ios::binary);
+	char magic[sizeof(FLIST_MAGIC)];
+	if (!ifs.read(magic, sizeof(magic)))
+		return false;
+	return !memcmp(magic, FLIST_MAGIC, sizeof(magic));
 }
 
-std::vector<std::string> load_flist_file(const std::string& flist_file) {
+std::shared_ptr<PathTable> load_flist_file(const std::string& flist_file) {
 	std::ifstream ifs;
 	ifs.exceptions(std::ofstream::failbit | std::ifstream::badbit);
 	ifs.open(flist_file);
 	ifs.exceptions(std::ifstream::badbit); // getline sets failbit on EOF
 
-	std::vector<std::string> fl;
+	auto fl = std::make_shared<PathTable>();
 	std::string s;
 	while (std::getline(ifs, s))
-		fl.push_back(s);
+		fl->push_back(s);
 	return fl;
 }
 
+// [begin, end) of paths starting with prefix in sorted flist
+std::pair<size_t, size_t> get_flist_prefix_range(const Flist& fl,
+	const std::string& prefix) {
+	std::string buf;
+	auto lower = [&](size_t lo, size_t hi, auto less) {
+		while (lo < hi) {
+			auto mid = lo + (hi - lo) / 2;
+			if (less(fl.get(mid, buf)))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	};
+	auto begin = lower(0, fl.size(), [&](std::string_view s) {
+		return s < prefix;
+	});
+	auto end = lower(begin, fl.size(), [&](std::string_view s) {
+		return s.starts_with(prefix);
+	});
+	return {begin, end};
+}
+
+// assigns flist entries to input directories they start with in parallel,
+// an entry can be in multiple inputs, order of entries is kept,
+// unmatched is index of the first entry with no input or flist size
+int assign_flist_prefix(const Flist& fl, const std::vector<std::string>& input,
+	unsigned int num_thread, std::vector<std::vector<size_t>>& l,
+	size_t& unmatched) {
+	const size_t min_entries = 1 << 16; // per thread
+	if (num_thread == 0)
+		num_thread = get_num_cpus();
+	num_thread = static_cast<unsigned int>(std::min<size_t>(num_thread,
+		(fl.size() + min_entries - 1) / min_entries));
+	num_thread = std::max(num_thread, 1u);
+
+	PrefixMatcher matcher(input);
+	std::vector<std::vector<std::vector<size_t>>> lv(num_thread,
+		std::vector<std::vector<size_t>>(input.size()));
+	std::vector<size_t> uv(num_thread);
+	std::vector<thread_assign_arg> argv;
+	auto n = (fl.size() + num_thread - 1) / num_thread;
+	for (unsigned int i = 0; i < num_thread; i++) {
+		auto begin = std::min(n * i, fl.size());
+		auto end = std::min(begin + n, fl.size());
+		argv.push_back({&fl, &matcher, begin, end, &lv[i], &uv[i]});
+	}
+
+	if (num_thread == 1) {
+		assign_handler(&argv[0]);
+	} else {
+		std::vector<Thread> thrv(num_thread);
+		for (unsigned int i = 0; i < num_thread; i++) {
+			auto ret = thrv[i].create(assign_handler, &argv[i]);
+			if (ret) {
+				for (unsigned int j = 0; j < i; j++)
+					thrv[j].join();
+				return -ret;
+			}
+		}
+		for (auto& thr : thrv) {
+			auto ret = thr.join();
+			if (ret)
+				return -ret;
+		}
+	}
+
+	unmatched = fl.size();
+	for (unsigned int i = 0; i < num_thread; i++)
+		if (uv[i] != std::get<3>(argv[i])) {
+			unmatched = uv[i];
+			break;
+		}
+	l.assign(input.size(), {});
+	for (size_t i = 0; i < input.size(); i++) {
+		size_t siz = 0;
+		for (const auto& v : lv)
+			siz += v[i].size();
+		l[i].reserve(siz);
+		for (auto& v : lv) {
+			l[i].insert(l[i].end(), v[i].begin(), v[i].end());
+			std::vector<size_t>().swap(v[i]);
+		}
+	}
+	return 0;
+}
+
 int create_flist_file(const std::vector<std::string>& input,
-	const std::string& flist_file, bool ignore_dot, bool force) {
+	const std::string& flist_file, bool ignore_dot, bool force,
+	unsigned int num_scanner, FlistFormat format) {
 	if (path_exists(flist_file)) {
 		if (force) {
 			if (get_raw_file_type(flist_file) != FileType::Reg)
@@ -53,21 +371,292 @@ int create_flist_file(const std::vector<std::string>& input,
 		}
 	}
 
-	std::vector<std::string> fl;
-	for (const auto& f : input) {
-		auto v = init_flist(f, ignore_dot);
-		std::cout << v.size() << " files scanned from " << f << std::endl;
-		for (const auto& s : v)
-			fl.push_back(s);
+	// file size is only recorded in binary format
+	std::vector<std::vector<ScanEntry>> fls;
+	auto ret = scan_flist(input, ignore_dot, format == FlistFormat::Binary,
+		num_scanner, fls);
+	if (ret < 0)
+		return ret;
+	std::vector<ScanEntry> fl;
+	for (size_t i = 0; i < input.size(); i++) {
+		auto& v = fls[i];
+		std::cout << v.size() << " files scanned from " << input[i]
+			<< std::endl;
+		std::move(v.begin(), v.end(), std::back_inserter(fl));
 	}
-	std::sort(fl.begin(), fl.end());
+	std::sort(fl.begin(), fl.end(),
+		[](const ScanEntry& a, const ScanEntry& b) {
+			return a.path < b.path;
+		});
 
-	std::ofstream ofs;
-	ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-	ofs.open(flist_file);
+	switch (format) {
+	case FlistFormat::Text:
+		return write_flist_file_text(fl, flist_file);
+	case FlistFormat::Binary:
+		return write_flist_file_binary(fl, flist_file);
+	default:
+		return -EINVAL;
+	}
+}
 
-	for (const auto& s : fl)
-		ofs << s << std::endl;
-	ofs.flush();
-	return 0;
+#ifdef CONFIG_CPPUNIT
+#include <cppunit/TestAssert.h>
+
+#include "./cppunit.h"
+
+void FlistTest::test_path_table(void) {
+	const std::vector<std::string> path_list{
+		"/path/to/xxx",
+		"",
+		"/",
+		"/path/to/yyy",
+	};
+	PathTable fl;
+	CPPUNIT_ASSERT_EQUAL(fl.size(), 0lu);
+	for (const auto& f : path_list)
+		fl.push_back(f);
+	CPPUNIT_ASSERT_EQUAL(fl.size(), path_list.size());
+	std::string buf;
+	for (size_t i = 0; i < path_list.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL(std::string(fl.get(i, buf)),
+			path_list[i]);
+		CPPUNIT_ASSERT_EQUAL(fl.get(i, buf).data()[
+			path_list[i].size()], '\0');
+	}
+
+	auto p = std::make_shared<const PathTable>(fl);
+	RangeFlist r(p, 1, 3);
+	CPPUNIT_ASSERT_EQUAL(r.size(), 2lu);
+	CPPUNIT_ASSERT_EQUAL(std::string(r.get(0, buf)), path_list[1]);
+	CPPUNIT_ASSERT_EQUAL(std::string(r.get(1, buf)), path_list[2]);
+	IndexFlist x(p, {3, 0, 3});
+	CPPUNIT_ASSERT_EQUAL(x.size(), 3lu);
+	CPPUNIT_ASSERT_EQUAL(std::string(x.get(0, buf)), path_list[3]);
+	CPPUNIT_ASSERT_EQUAL(std::string(x.get(1, buf)), path_list[0]);
+	CPPUNIT_ASSERT_EQUAL(std::string(x.get(2, buf)), path_list[3]);
 }
+
+void FlistTest::test_shard_flist(void) {
+	auto p = std::make_shared<PathTable>();
+	for (auto i = 0; i < 10; i++)
+		p->push_back(std::to_string(i));
+	std::string buf;
+	StrideFlist x(p, 1, 3);
+	CPPUNIT_ASSERT_EQUAL(x.size(), 3lu);
+	CPPUNIT_ASSERT_EQUAL(std::string(x.get(0, buf)), std::string("1"));
+	CPPUNIT_ASSERT_EQUAL(std::string(x.get(1, buf)), std::string("4"));
+	CPPUNIT_ASSERT_EQUAL(std::string(x.get(2, buf)), std::string("7"));
+	CPPUNIT_ASSERT_EQUAL(StrideFlist(p, 0, 3).size(), 4lu);
+	CPPUNIT_ASSERT_EQUAL(StrideFlist(p, 2, 3).size(), 3lu);
+	CPPUNIT_ASSERT_EQUAL(StrideFlist(p, 10, 16).size(), 0lu);
+
+	const auto n = FlistCursor::BATCH_SIZE * 2 + 1;
+	FlistCursor c(n);
+	size_t begin, end;
+	unsigned long pass;
+	c.next(begin, end, pass);
+	CPPUNIT_ASSERT_EQUAL(begin, 0lu);
+	CPPUNIT_ASSERT_EQUAL(end, FlistCursor::BATCH_SIZE);
+	CPPUNIT_ASSERT_EQUAL(pass, 0lu);
+	c.next(begin, end, pass);
+	c.next(begin, end, pass);
+	CPPUNIT_ASSERT_EQUAL(begin, FlistCursor::BATCH_SIZE * 2);
+	CPPUNIT_ASSERT_EQUAL(end, n);
+	CPPUNIT_ASSERT_EQUAL(pass, 0lu);
+	c.next(begin, end, pass);
+	CPPUNIT_ASSERT_EQUAL(begin, 0lu);
+	CPPUNIT_ASSERT_EQUAL(pass, 1lu);
+}
+
+void FlistTest::test_front_coded_flist(void) {
+	std::vector<std::string> path_list{
+		"",
+		"/",
+		"/path",
+		"/path/to",
+		"/path/to/xxx",
+		"/path/to/xxy",
+		"/path/to/yyy",
+		"/path/from/zzz",
+		"/x",
+		"/x",
+	};
+	for (auto i = 0; i < 100; i++)
+		path_list.push_back("/path/to/dir/" + std::to_string(i) +
+			std::string(static_cast<size_t>(i * 3), 'x'));
+	std::sort(path_list.begin(), path_list.end());
+	path_list.push_back("/unsorted");
+	path_list.push_back("/path/to/unsorted");
+
+	FrontCodedFlist fl;
+	for (const auto& f : path_list)
+		fl.push_back(f);
+	fl.shrink_to_fit();
+	CPPUNIT_ASSERT_EQUAL(fl.size(), path_list.size());
+	std::string buf;
+	for (size_t i = 0; i < path_list.size(); i++)
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(std::to_string(i),
+			std::string(fl.get(i, buf)), path_list[i]);
+	// reverse order to decode with a dirty buffer
+	for (size_t i = path_list.size(); i > 0; i--)
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(std::to_string(i - 1),
+			std::string(fl.get(i - 1, buf)), path_list[i - 1]);
+
+	// sorted paths share prefixes
+	auto siz = 0lu;
+	for (const auto& f : path_list)
+		siz += f.size();
+	CPPUNIT_ASSERT(fl.get_memory_size() < siz);
+}
+
+void FlistTest::test_create_flist_file(void) {
+	if (!is_linux())
+		return;
+
+	auto d = join_path("/tmp", "dirload_flist_test_" + get_time_string());
+	std::filesystem::create_directories(join_path(d, "a/b"));
+	const std::vector<std::string> file_list{
+		join_path(d, "x"),
+		join_path(d, "a/y"),
+		join_path(d, "a/b/z"),
+	};
+	for (const auto& f : file_list)
+		std::ofstream(f) << f;
+	std::vector<std::string> l(file_list);
+	std::sort(l.begin(), l.end());
+	std::string buf;
+
+	for (auto format : {FlistFormat::Text, FlistFormat::Binary}) {
+		auto f = join_path(d, "flist");
+		std::filesystem::remove(f);
+		CPPUNIT_ASSERT_EQUAL(create_flist_file({d}, f, false, false, 2,
+			format), 0);
+		CPPUNIT_ASSERT_EQUAL(create_flist_file({d}, f, false, false, 2,
+			format), -EEXIST);
+		CPPUNIT_ASSERT_EQUAL(is_binary_flist_file(f),
+			format == FlistFormat::Binary);
+		if (format == FlistFormat::Text) {
+			auto fl = load_flist_file(f);
+			CPPUNIT_ASSERT_EQUAL(fl->size(), l.size());
+			FileType t;
+			off_t size;
+			for (size_t i = 0; i < l.size(); i++) {
+				CPPUNIT_ASSERT_EQUAL(std::string(fl->get(i,
+					buf)), l[i]);
+				CPPUNIT_ASSERT(!fl->get_stat(i, t, size));
+			}
+			continue;
+		}
+		auto fl = std::make_shared<const MmapFlist>(f);
+		CPPUNIT_ASSERT(fl->is_sorted());
+		CPPUNIT_ASSERT_EQUAL(fl->size(), l.size());
+		for (size_t i = 0; i < l.size(); i++) {
+			CPPUNIT_ASSERT_EQUAL(std::string(fl->get(i, buf)), l[i]);
+			CPPUNIT_ASSERT_EQUAL(fl->get(i, buf).data()[
+				l[i].size()], '\0');
+			FileType t;
+			off_t size;
+			CPPUNIT_ASSERT(fl->get_stat(i, t, size));
+			CPPUNIT_ASSERT_EQUAL(t, FileType::Reg);
+			CPPUNIT_ASSERT_EQUAL(size,
+				static_cast<off_t>(l[i].size()));
+		}
+		// cached stat is visible through a view of the flist
+		RangeFlist r(fl, 1, l.size());
+		FileType t;
+		off_t size;
+		CPPUNIT_ASSERT(r.get_stat(0, t, size));
+		CPPUNIT_ASSERT_EQUAL(size, static_cast<off_t>(l[1].size()));
+	}
+	std::filesystem::remove_all(d);
+}
+
+void FlistTest::test_get_flist_prefix_range(void) {
+	PathTable fl;
+	for (const auto& f : {"/a/x", "/aa/x", "/b/x", "/b/y", "/b/z/x", "/bb",
+		"/c"})
+		fl.push_back(f);
+	const std::vector<std::tuple<std::string, size_t, size_t>> range_list{
+		{"/", 0, 7},
+		{"/a", 0, 2},
+		{"/a/", 0, 1},
+		{"/b", 2, 6},
+		{"/b/", 2, 5},
+		{"/b/z", 4, 5},
+		{"/c", 6, 7},
+		{"/0", 0, 0},
+		{"/d", 7, 7},
+	};
+	for (const auto& [prefix, begin, end] : range_list) {
+		auto [b, e] = get_flist_prefix_range(fl, prefix);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(prefix, b, begin);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(prefix, e, end);
+	}
+}
+
+void FlistTest::test_prefix_matcher(void) {
+	const std::vector<std::string> input{
+		"/b",
+		"/a/b",
+		"/a",
+		"/a/b/c",
+		"/a/bb",
+		"/c/d",
+	};
+	PrefixMatcher matcher(input);
+	const std::vector<std::tuple<std::string, std::vector<size_t>>>
+		match_list{
+		{"/a/b/c/d", {1, 2, 3}},
+		{"/a/b/d", {1, 2}},
+		{"/a/bb/x", {1, 2, 4}},
+		{"/a/ba", {1, 2}},
+		{"/a/x", {2}},
+		{"/b/x", {0}},
+		{"/c/x", {}},
+		{"/c/d/x", {5}},
+		{"/", {}},
+		{"", {}},
+	};
+	for (const auto& [f, indices] : match_list) {
+		std::vector<size_t> v;
+		auto n = matcher.match(f, [&](size_t i) {
+			v.push_back(i);
+		});
+		std::sort(v.begin(), v.end());
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(f, n, v.size());
+		CPPUNIT_ASSERT_MESSAGE(f, v == indices);
+	}
+}
+
+void FlistTest::test_assign_flist_prefix(void) {
+	const std::vector<std::string> input{"/a", "/a/b", "/c"};
+	PathTable fl;
+	for (auto i = 0; i < 200000; i++)
+		fl.push_back(input[static_cast<size_t>(i) % input.size()] +
+			"/" + std::to_string(i));
+	for (auto num_thread : {1u, 4u}) {
+		std::vector<std::vector<size_t>> l;
+		size_t unmatched;
+		CPPUNIT_ASSERT_EQUAL(assign_flist_prefix(fl, input, num_thread,
+			l, unmatched), 0);
+		CPPUNIT_ASSERT_EQUAL(unmatched, fl.size());
+		CPPUNIT_ASSERT_EQUAL(l.size(), input.size());
+		// "/a/b/..." is also in "/a"
+		CPPUNIT_ASSERT_EQUAL(l[0].size(), 133334lu);
+		CPPUNIT_ASSERT_EQUAL(l[1].size(), 66667lu);
+		CPPUNIT_ASSERT_EQUAL(l[2].size(), 66666lu);
+		for (const auto& v : l)
+			CPPUNIT_ASSERT(std::is_sorted(v.begin(), v.end()));
+	}
+
+	fl.push_back("/d");
+	fl.push_back("/e");
+	std::vector<std::vector<size_t>> l;
+	size_t unmatched;
+	CPPUNIT_ASSERT_EQUAL(assign_flist_prefix(fl, input, 4, l, unmatched),
+		0);
+	CPPUNIT_ASSERT_EQUAL(unmatched, fl.size() - 2);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FlistTest);
+#endif
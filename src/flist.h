@@ -3,9 +3,335 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <atomic>
 
-std::vector<std::string> init_flist(const std::string&, bool);
-std::vector<std::string> load_flist_file(const std::string&);
+#include <cstdint>
+#include <cassert>
+
+#include <sys/types.h>
+
+#include "./util.h"
+
+enum class FlistFormat {
+	Text,
+	Binary,
+};
+
+// read-only list of paths shared by worker threads
+class Flist {
+	public:
+	virtual ~Flist(void) = default;
+	virtual size_t size(void) const = 0;
+	// returned path is either in flist or decoded into the buffer
+	virtual std::string_view get(size_t, std::string&) const = 0;
+	// file type and size cached in flist if any, saves lstat(2)
+	virtual bool get_stat([[maybe_unused]] size_t i,
+		[[maybe_unused]] FileType& t,
+		[[maybe_unused]] off_t& size) const {
+		return false;
+	}
+};
+
+// paths packed in a single arena shared by all threads,
+// memory is O(files) regardless of number of threads
+class PathTable: public Flist {
+	public:
+	PathTable(void):
+		_arena{},
+		_entries{} {
+	}
+	void reserve(size_t count, size_t bytes) {
+		_entries.reserve(count);
+		_arena.reserve(bytes);
+	}
+	void push_back(std::string_view s) {
+		_entries.push_back({_arena.size(), s.size()});
+		_arena.insert(_arena.end(), s.begin(), s.end());
+		_arena.push_back('\0');
+	}
+	size_t size(void) const override {
+		return _entries.size();
+	}
+	std::string_view get(size_t i,
+		[[maybe_unused]] std::string& buf) const override {
+		const auto& e = _entries[i];
+		return std::string_view(_arena.data() + e.off, e.len);
+	}
+
+	private:
+	struct Entry {
+		size_t off;
+		size_t len;
+	};
+
+	std::vector<char> _arena;
+	std::vector<Entry> _entries;
+};
+
+// front coded paths, each block starts with a full path followed by
+// (common prefix length, suffix) of the previous path,
+// compact when paths are sorted
+class FrontCodedFlist: public Flist {
+	public:
+	static const size_t BLOCK_SIZE = 16;
+
+	FrontCodedFlist(void):
+		_data{},
+		_blocks{},
+		_count(0),
+		_last{} {
+	}
+	void push_back(std::string_view);
+	void shrink_to_fit(void);
+	size_t size(void) const override {
+		return _count;
+	}
+	std::string_view get(size_t, std::string&) const override;
+	size_t get_memory_size(void) const {
+		return _data.capacity() + _blocks.capacity() * sizeof(size_t);
+	}
+
+	private:
+	std::vector<char> _data;
+	std::vector<size_t> _blocks; // offset of each block in data
+	size_t _count;
+	std::string _last; // only used while building
+};
+
+// [begin, end) of another flist
+class RangeFlist: public Flist {
+	public:
+	RangeFlist(std::shared_ptr<const Flist> fl, size_t begin, size_t end):
+		_fl(fl),
+		_begin(begin),
+		_end(end) {
+	}
+	size_t size(void) const override {
+		return _end - _begin;
+	}
+	std::string_view get(size_t i,
+		std::string& buf) const override {
+		return _fl->get(_begin + i, buf);
+	}
+	bool get_stat(size_t i, FileType& t, off_t& size) const override {
+		return _fl->get_stat(_begin + i, t, size);
+	}
+
+	private:
+	std::shared_ptr<const Flist> _fl;
+	size_t _begin;
+	size_t _end;
+};
+
+// every n-th entry of another flist starting from k
+class StrideFlist: public Flist {
+	public:
+	StrideFlist(std::shared_ptr<const Flist> fl, size_t k, size_t n):
+		_fl(fl),
+		_k(k),
+		_n(n) {
+		assert(_n > 0);
+	}
+	size_t size(void) const override {
+		auto siz = _fl->size();
+		return siz > _k ? (siz - _k + _n - 1) / _n : 0;
+	}
+	std::string_view get(size_t i,
+		std::string& buf) const override {
+		return _fl->get(_k + i * _n, buf);
+	}
+	bool get_stat(size_t i, FileType& t, off_t& size) const override {
+		return _fl->get_stat(_k + i * _n, t, size);
+	}
+
+	private:
+	std::shared_ptr<const Flist> _fl;
+	size_t _k;
+	size_t _n;
+};
+
+// hands out batches of an flist to threads sharing it,
+// batches are numbered per pass so none is skipped across passes
+class FlistCursor {
+	public:
+	static constexpr size_t BATCH_SIZE = 64;
+
+	explicit FlistCursor(size_t siz):
+		_size(siz),
+		_num_batch((siz + BATCH_SIZE - 1) / BATCH_SIZE),
+		_next(0) {
+		assert(_num_batch > 0);
+	}
+	void next(size_t& begin, size_t& end, unsigned long& pass) {
+		auto k = _next.fetch_add(1, std::memory_order_relaxed);
+		pass = k / _num_batch;
+		begin = (k % _num_batch) * BATCH_SIZE;
+		end = std::min(begin + BATCH_SIZE, _size);
+	}
+
+	private:
+	size_t _size;
+	unsigned long _num_batch;
+	std::atomic<unsigned long> _next;
+};
+
+// subset of another flist by index
+class IndexFlist: public Flist {
+	public:
+	IndexFlist(std::shared_ptr<const Flist> fl,
+		std::vector<size_t>&& index):
+		_fl(fl),
+		_index(std::move(index)) {
+	}
+	size_t size(void) const override {
+		return _index.size();
+	}
+	std::string_view get(size_t i,
+		std::string& buf) const override {
+		return _fl->get(_index[i], buf);
+	}
+	bool get_stat(size_t i, FileType& t, off_t& size) const override {
+		return _fl->get_stat(_index[i], t, size);
+	}
+
+	private:
+	std::shared_ptr<const Flist> _fl;
+	std::vector<size_t> _index;
+};
+
+// binary flist file layout, all integers in host byte order
+//   header
+//   entry table (count entries)
+//   string blob (NUL terminated paths)
+const char FLIST_MAGIC[8] = {'D', 'I', 'R', 'L', 'F', 'L', 'S', 'T'};
+const uint32_t FLIST_VERSION = 1;
+const uint32_t FLIST_FLAG_SORTED = 1;
+
+struct FlistHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t count;
+	uint64_t entry_off;
+	uint64_t blob_off;
+	uint64_t blob_size;
+};
+
+struct FlistEntry {
+	uint64_t off; // offset in blob
+	int64_t size; // -1 if unknown
+	uint32_t len; // excluding NUL
+	uint32_t type; // FileType
+};
+
+// mmap'd binary flist file, paths are not copied
+class MmapFlist: public Flist {
+	public:
+	explicit MmapFlist(const std::string&);
+	MmapFlist(const MmapFlist&) = delete;
+	MmapFlist& operator=(const MmapFlist&) = delete;
+	~MmapFlist(void);
+
+	size_t size(void) const override {
+		return _count;
+	}
+	std::string_view get(size_t i,
+		[[maybe_unused]] std::string& buf) const override {
+		const auto& e = _entries[i];
+		return std::string_view(_blob + e.off, e.len);
+	}
+	bool get_stat(size_t i, FileType& t, off_t& size) const override {
+		const auto& e = _entries[i];
+		if (e.size < 0)
+			return false;
+		t = static_cast<FileType>(e.type);
+		size = static_cast<off_t>(e.size);
+		return true;
+	}
+	bool is_sorted(void) const {
+		return _flags & FLIST_FLAG_SORTED;
+	}
+
+	private:
+	void* _map;
+	size_t _map_size;
+	uint32_t _flags;
+	size_t _count;
+	const FlistEntry* _entries;
+	const char* _blob;
+};
+
+// finds input directories which are prefixes of a path
+// in O(log inputs + nesting depth of inputs)
+class PrefixMatcher {
+	public:
+	explicit PrefixMatcher(const std::vector<std::string>&);
+
+	// calls fn with index of each matched input
+	template <class F> size_t match(std::string_view s, F fn) const {
+		auto it = std::upper_bound(_sorted.begin(), _sorted.end(), s,
+			[](std::string_view a, const std::string& b) {
+				return a < b;
+			});
+		// all inputs which are prefixes of s are ancestors of
+		// the largest input not greater than s
+		auto i = static_cast<long>(it - _sorted.begin()) - 1;
+		size_t n = 0;
+		while (i >= 0) {
+			auto j = static_cast<size_t>(i);
+			if (s.starts_with(_sorted[j])) {
+				fn(_index[j]);
+				n++;
+			}
+			i = _parent[j];
+		}
+		return n;
+	}
+
+	private:
+	std::vector<std::string> _sorted;
+	std::vector<size_t> _index; // index in input
+	std::vector<long> _parent; // longest input which is a prefix, or -1
+};
+
+bool is_binary_flist_file(const std::string&);
+std::shared_ptr<PathTable> load_flist_file(const std::string&);
+std::pair<size_t, size_t> get_flist_prefix_range(const Flist&,
+	const std::string&);
+int assign_flist_prefix(const Flist&, const std::vector<std::string>&,
+	unsigned int, std::vector<std::vector<size_t>>&, size_t&);
 int create_flist_file(const std::vector<std::string>&, const std::string&,
-	bool, bool);
+	bool, bool, unsigned int, FlistFormat);
+
+#ifdef CONFIG_CPPUNIT
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class FlistTest: public CPPUNIT_NS::TestFixture {
+	public:
+	CPPUNIT_TEST_SUITE(FlistTest);
+	CPPUNIT_TEST(test_path_table);
+	CPPUNIT_TEST(test_shard_flist);
+	CPPUNIT_TEST(test_front_coded_flist);
+	CPPUNIT_TEST(test_create_flist_file);
+	CPPUNIT_TEST(test_get_flist_prefix_range);
+	CPPUNIT_TEST(test_prefix_matcher);
+	CPPUNIT_TEST(test_assign_flist_prefix);
+	CPPUNIT_TEST_SUITE_END();
+
+	private:
+	void test_path_table(void);
+	void test_shard_flist(void);
+	void test_front_coded_flist(void);
+	void test_create_flist_file(void);
+	void test_get_flist_prefix_range(void);
+	void test_prefix_matcher(void);
+	void test_assign_flist_prefix(void);
+};
+#endif
 #endif // SRC_FLIST_H_
@@ -8,6 +8,10 @@
 #include <cstdint>
 #include <csignal>
 
+#include "./dist.h"
+#include "./flist.h"
+#include "./util.h"
+
 enum class WritePathsType {
 	Dir,
 	Reg,
@@ -20,6 +24,76 @@ enum class PathIter {
 	Ordered,
 	Reverse,
 	Random,
+	Zipf,
+	Hotspot,
+	Gaussian,
+};
+
+enum class Shard {
+	None,
+	Contiguous,
+	Interleaved,
+	Dynamic,
+};
+
+enum class ReadEngine {
+	Stream,
+	Psync,
+	Direct,
+	Uring,
+	Mmap,
+	Splice,
+	Sendfile,
+};
+
+enum class ReadPattern {
+	Seq,
+	Random,
+	Strided,
+};
+
+enum class Madvise {
+	Normal,
+	Sequential,
+	Random,
+	Willneed,
+	Hugepage,
+};
+
+enum class WriteData {
+	Zero,
+	Pattern,
+	Random,
+	Compress,
+	Dedup,
+};
+
+enum class WriteTarget {
+	New,
+	Overwrite,
+	Append,
+};
+
+enum class WriteAlloc {
+	None,
+	Fallocate,
+	ZeroRange,
+	PunchHole,
+	Collapse,
+};
+
+enum class SyncMethod {
+	Fsync,
+	Syncfs,
+	Writebehind,
+};
+
+enum class WriteEngine {
+	Stream,
+	Psync,
+	Direct,
+	Dsync,
+	Uring,
 };
 
 extern volatile sig_atomic_t interrupted;
@@ -39,20 +113,47 @@ namespace opt {
 	extern bool follow_symlink;
 	extern unsigned long read_buffer_size;
 	extern long read_size;
+	extern ReadEngine read_engine;
+	extern Madvise madvise;
+	extern ReadPattern read_pattern;
+	extern unsigned long read_block_size;
+	extern unsigned long read_ops;
 	extern unsigned long write_buffer_size;
 	extern long write_size;
-	extern bool random_write_data;
+	extern SizeDist write_file_size;
+	extern BufferType buffer_type;
+	extern WriteEngine write_engine;
+	extern unsigned int iodepth;
+	extern WriteData write_data;
+	extern double write_data_compress;
+	extern double write_data_dedup;
 	extern long num_write_paths;
 	extern bool truncate_write_paths;
+	extern WriteAlloc write_alloc;
+	extern WriteTarget write_target;
 	extern bool fsync_write_paths;
 	extern bool dirsync_write_paths;
+	extern unsigned long sync_batch;
+	extern unsigned long sync_batch_ms;
+	extern SyncMethod sync_method;
 	extern bool keep_write_paths;
 	extern bool clean_write_paths;
 	extern std::string write_paths_base;
 	extern std::vector<WritePathsType> write_paths_type;
 	extern PathIter path_iter;
+	extern double zipf_theta;
+	extern double hotspot_files;
+	extern double hotspot_ops;
+	extern double gaussian_stddev;
+	extern Shard shard;
 	extern std::string flist_file;
 	extern bool flist_file_create;
+	extern FlistFormat flist_file_format;
+	extern bool flist_cached_stat;
+	extern bool flist_compress;
+	extern bool flist_stream;
+	extern unsigned int num_scanner;
+	extern long seed;
 	extern bool force;
 	extern bool verbose;
 	extern bool debug;
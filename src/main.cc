@@ -11,6 +11,7 @@
 #include <cassert>
 
 #include <getopt.h>
+#include <sys/mman.h>
 
 #include "./cppunit.h"
 #include "./dir.h"
@@ -19,6 +20,7 @@
 #include "./log.h"
 #include "./stat.h"
 #include "./thread.h"
+#include "./unlink.h"
 #include "./util.h"
 #include "./worker.h"
 
@@ -41,21 +43,48 @@ namespace opt {
 	bool follow_symlink;
 	unsigned long read_buffer_size = 1 << 16;
 	long read_size = -1;
+	ReadEngine read_engine = ReadEngine::Stream;
+	Madvise madvise = Madvise::Normal;
+	ReadPattern read_pattern = ReadPattern::Seq;
+	unsigned long read_block_size;
+	unsigned long read_ops = 1;
 	unsigned long write_buffer_size = 1 << 16;
 	long write_size = -1;
-	bool random_write_data;
+	SizeDist write_file_size;
+	WriteEngine write_engine = WriteEngine::Stream;
+	BufferType buffer_type = BufferType::Heap;
+	unsigned int iodepth = 32;
+	WriteData write_data = WriteData::Pattern;
+	double write_data_compress = 2;
+	double write_data_dedup = 50;
 	long num_write_paths = 1 << 10;
 	bool truncate_write_paths;
+	WriteAlloc write_alloc = WriteAlloc::None;
+	WriteTarget write_target = WriteTarget::New;
 	bool fsync_write_paths;
 	bool dirsync_write_paths;
+	unsigned long sync_batch;
+	unsigned long sync_batch_ms;
+	SyncMethod sync_method = SyncMethod::Fsync;
 	bool keep_write_paths;
 	bool clean_write_paths;
 	std::string write_paths_base("x");
 	std::vector<WritePathsType> write_paths_type =
 		{WritePathsType::Dir, WritePathsType::Reg};
 	PathIter path_iter = PathIter::Ordered;
+	double zipf_theta = 0.99;
+	double hotspot_files = 20;
+	double hotspot_ops = 80;
+	double gaussian_stddev = 10;
+	Shard shard = Shard::None;
 	std::string flist_file;
 	bool flist_file_create;
+	FlistFormat flist_file_format = FlistFormat::Text;
+	bool flist_cached_stat;
+	bool flist_compress;
+	bool flist_stream;
+	unsigned int num_scanner;
+	long seed = -1;
 	bool force;
 	bool verbose;
 	bool debug;
@@ -95,6 +124,9 @@ void print_build_options(void) {
 #endif
 #ifdef CONFIG_CPPUNIT
 		<< "  cppunit" << std::endl
+#endif
+#ifdef CONFIG_IO_URING
+		<< "  io_uring" << std::endl
 #endif
 		;
 }
@@ -127,21 +159,71 @@ void usage(const std::string& arg) {
 		<< "  --read_size - Read residual size per file read, "
 		<< "use < read_buffer_size random size if 0 (default -1)"
 		<< std::endl
+		<< "  --read_engine - Read engine "
+		<< "[stream|psync|direct|uring|mmap|splice|sendfile] "
+		<< "(default stream)"
+		<< std::endl
+		<< "  --madvise - madvise(2) advice for mmap read engine "
+		<< "[normal|sequential|random|willneed|hugepage] "
+		<< "(default normal)" << std::endl
+		<< "  --read_pattern - Read pattern within a file for psync "
+		<< "and direct read engines [seq|random|strided] (default seq)"
+		<< std::endl
+		<< "  --read_block_size - Read size per random or strided read, "
+		<< "use read_buffer_size if 0 (default 0)" << std::endl
+		<< "  --read_ops - Number of random or strided reads per file "
+		<< "read (default 1)" << std::endl
 		<< "  --write_buffer_size - Write buffer size (default 65536)"
 		<< std::endl
 		<< "  --write_size - Write residual size per file write, "
 		<< "use < write_buffer_size random size if 0 (default -1)"
 		<< std::endl
-		<< "  --random_write_data - Use pseudo random write data"
+		<< "  --write_file_size - Write size per regular file in "
+		<< "write_buffer_size chunks, overrides write_size "
+		<< "[<size>|uniform:<min>:<max>|exp:<mean>] with K, M, G or T "
+		<< "suffix" << std::endl
+		<< "  --write_engine - Write engine "
+		<< "[stream|psync|direct|dsync|uring] (default stream)"
+		<< std::endl
+		<< "  --buffer_type - Read and write buffer allocation "
+		<< "[heap|thp|hugetlb] (default heap)" << std::endl
+		<< "  --iodepth - Number of in-flight files per thread for "
+		<< "uring engine (default 32)" << std::endl
+		<< "  --write_data - Write data [zero|pattern|random|"
+		<< "compress[:ratio]|dedup[:pct]] (default pattern, "
+		<< "compress:2, dedup:50)" << std::endl
+		<< "  --random_write_data - Same as --write_data=random"
 		<< std::endl
 		<< "  --num_write_paths - Exit writer threads after creating "
-		<< "specified files or directories if > 0 (default 1024)"
+		<< "or updating specified files or directories if > 0 "
+		<< "(default 1024)"
 		<< std::endl
 		<< "  --truncate_write_paths - ftruncate(2) write paths for "
 		<< "regular files instead of write(2)" << std::endl
-		<< "  --fsync_write_paths - fsync(2) write paths" << std::endl
+		<< "  --write_alloc - fallocate(2) write paths for regular "
+		<< "files before or after write(2) for psync, direct and dsync "
+		<< "write engines [none|fallocate|zero_range|punch_hole|"
+		<< "collapse] (default none)" << std::endl
+		<< "  --write_target - Create write paths, or overwrite or "
+		<< "append to existing write paths kept by previous runs "
+		<< "for psync, direct and dsync write engines "
+		<< "[new|overwrite|append] (default new)" << std::endl
+		<< "  --fsync_write_paths - fsync(2) write paths, regular files "
+		<< "after data is written" << std::endl
 		<< "  --dirsync_write_paths - fsync(2) parent directories of "
 		<< "write paths" << std::endl
+		<< "  --sync_batch - Defer --fsync_write_paths and "
+		<< "--dirsync_write_paths until specified write paths are "
+		<< "created if > 0, parent directories are synced once per "
+		<< "batch, batch latency includes file and directory syncs"
+		<< std::endl
+		<< "  --sync_batch_ms - Defer --fsync_write_paths and "
+		<< "--dirsync_write_paths for specified milliseconds if > 0"
+		<< std::endl
+		<< "  --sync_method - Method to commit a batch, syncfs(2) once "
+		<< "or sync_file_range(2) write-behind followed by "
+		<< "fdatasync(2) for psync, direct and dsync write engines "
+		<< "[fsync|syncfs|writebehind] (default fsync)" << std::endl
 		<< "  --keep_write_paths - Do not unlink write paths after "
 		<< "writer threads exit" << std::endl
 		<< "  --clean_write_paths - Unlink existing write paths and exit"
@@ -151,11 +233,33 @@ void usage(const std::string& arg) {
 		<< "  --write_paths_type - File types for write paths "
 		<< "[d|r|s|l] (default dr)" << std::endl
 		<< "  --path_iter - <paths> iteration type "
-		<< "[walk|ordered|reverse|random] (default ordered)"
+		<< "[walk|ordered|reverse|random|zipf[:theta]|"
+		<< "hotspot[:pct_files[:pct_ops]]|gaussian[:pct_stddev]] "
+		<< "(default ordered, zipf:0.99, hotspot:20:80, gaussian:10)"
 		<< std::endl
+		<< "  --shard - Split flist of an input among its readers "
+		<< "or writers [none|contiguous|interleaved|dynamic] "
+		<< "(default none)" << std::endl
 		<< "  --flist_file - Path to flist file" << std::endl
 		<< "  --flist_file_create - Create flist file and exit"
 		<< std::endl
+		<< "  --flist_file_format - Format of flist file to create "
+		<< "[text|binary] (default text)" << std::endl
+		<< "  --flist_cached_stat - Readers use file type and size in "
+		<< "binary flist instead of lstat(2) unless --stat_only"
+		<< std::endl
+		<< "  --flist_compress - Keep flist front coded in memory"
+		<< std::endl
+		<< "  --flist_stream - Stream flist file in chunks instead of "
+		<< "loading it (ordered iteration only, all threads advance "
+		<< "at the pace of the slowest one)" << std::endl
+		<< "  --num_scanner - Number of threads to scan input "
+		<< "directories, assign flist to them or clean write paths "
+		<< "(default 0 for number of CPUs)"
+		<< std::endl
+		<< "  --seed - Seed for pseudo random numbers of each thread "
+		<< "and order of zipf and hotspot entries, use random seed if "
+		<< "< 0 (default -1)" << std::endl
 		<< "  --force - Enable force mode" << std::endl
 		<< "  --verbose - Enable verbose print" << std::endl
 		<< "  --debug - Enable debug mode" << std::endl
@@ -190,48 +294,237 @@ int handle_long_option(const std::string& name, const std::string& arg) {
 		opt::follow_symlink = true;
 	} else if (name == "read_buffer_size") {
 		opt::read_buffer_size = std::stoul(arg);
-		if (opt::read_buffer_size > MAX_BUFFER_SIZE) {
+		if (opt::read_buffer_size == 0 ||
+			opt::read_buffer_size > MAX_BUFFER_SIZE) {
 			std::cout << "Invalid read buffer size "
 				<< opt::read_buffer_size << std::endl;
 			return -1;
 		}
 	} else if (name == "read_size") {
 		opt::read_size = std::stol(arg);
-		if (opt::read_size < -1) {
+		if (opt::read_size < -1)
 			opt::read_size = -1;
-		} else if (opt::read_size > static_cast<long>(MAX_BUFFER_SIZE)) {
-			std::cout << "Invalid read size "
-				<< opt::read_size << std::endl;
+	} else if (name == "read_engine") {
+		if (arg == "stream") {
+			opt::read_engine = ReadEngine::Stream;
+		} else if (arg == "psync") {
+			opt::read_engine = ReadEngine::Psync;
+		} else if (arg == "direct") {
+			opt::read_engine = ReadEngine::Direct;
+		} else if (arg == "uring") {
+#ifdef CONFIG_IO_URING
+			opt::read_engine = ReadEngine::Uring;
+#else
+			std::cout << "io_uring unsupported" << std::endl;
+			return -1;
+#endif
+		} else if (arg == "mmap") {
+			opt::read_engine = ReadEngine::Mmap;
+		} else if (arg == "splice" || arg == "sendfile") {
+			if (!is_linux()) {
+				std::cout << arg << " unsupported" << std::endl;
+				return -1;
+			}
+			if (arg == "splice")
+				opt::read_engine = ReadEngine::Splice;
+			else
+				opt::read_engine = ReadEngine::Sendfile;
+		} else {
+			std::cout << "Invalid read engine " << arg << std::endl;
+			return -1;
+		}
+	} else if (name == "madvise") {
+		if (arg == "normal") {
+			opt::madvise = Madvise::Normal;
+		} else if (arg == "sequential") {
+			opt::madvise = Madvise::Sequential;
+		} else if (arg == "random") {
+			opt::madvise = Madvise::Random;
+		} else if (arg == "willneed") {
+			opt::madvise = Madvise::Willneed;
+		} else if (arg == "hugepage") {
+#ifdef MADV_HUGEPAGE
+			opt::madvise = Madvise::Hugepage;
+#else
+			std::cout << "MADV_HUGEPAGE unsupported" << std::endl;
+			return -1;
+#endif
+		} else {
+			std::cout << "Invalid madvise advice " << arg
+				<< std::endl;
+			return -1;
+		}
+	} else if (name == "read_pattern") {
+		if (arg == "seq") {
+			opt::read_pattern = ReadPattern::Seq;
+		} else if (arg == "random") {
+			opt::read_pattern = ReadPattern::Random;
+		} else if (arg == "strided") {
+			opt::read_pattern = ReadPattern::Strided;
+		} else {
+			std::cout << "Invalid read pattern " << arg << std::endl;
+			return -1;
+		}
+	} else if (name == "read_block_size") {
+		opt::read_block_size = std::stoul(arg);
+	} else if (name == "read_ops") {
+		opt::read_ops = std::stoul(arg);
+		if (opt::read_ops == 0) {
+			std::cout << "Invalid read ops " << opt::read_ops
+				<< std::endl;
 			return -1;
 		}
 	} else if (name == "write_buffer_size") {
 		opt::write_buffer_size = std::stoul(arg);
-		if (opt::write_buffer_size > MAX_BUFFER_SIZE) {
+		if (opt::write_buffer_size == 0 ||
+			opt::write_buffer_size > MAX_BUFFER_SIZE) {
 			std::cout << "Invalid write buffer size "
 				<< opt::write_buffer_size << std::endl;
 			return -1;
 		}
 	} else if (name == "write_size") {
 		opt::write_size = std::stol(arg);
-		if (opt::write_size < -1) {
+		if (opt::write_size < -1)
 			opt::write_size = -1;
-		} else if (opt::write_size > static_cast<long>(MAX_BUFFER_SIZE)) {
-			std::cout << "Invalid write size "
-				<< opt::write_size << std::endl;
+	} else if (name == "write_file_size") {
+		opt::write_file_size = SizeDist(arg);
+	} else if (name == "write_engine") {
+		if (arg == "stream") {
+			opt::write_engine = WriteEngine::Stream;
+		} else if (arg == "psync") {
+			opt::write_engine = WriteEngine::Psync;
+		} else if (arg == "direct") {
+			opt::write_engine = WriteEngine::Direct;
+		} else if (arg == "dsync") {
+			opt::write_engine = WriteEngine::Dsync;
+		} else if (arg == "uring") {
+#ifdef CONFIG_IO_URING
+			opt::write_engine = WriteEngine::Uring;
+#else
+			std::cout << "io_uring unsupported" << std::endl;
+			return -1;
+#endif
+		} else {
+			std::cout << "Invalid write engine " << arg << std::endl;
+			return -1;
+		}
+	} else if (name == "buffer_type") {
+		if (arg == "heap") {
+			opt::buffer_type = BufferType::Heap;
+		} else if (arg == "thp") {
+			opt::buffer_type = BufferType::Thp;
+		} else if (arg == "hugetlb") {
+			opt::buffer_type = BufferType::Hugetlb;
+		} else {
+			std::cout << "Invalid buffer type " << arg << std::endl;
+			return -1;
+		}
+	} else if (name == "iodepth") {
+		opt::iodepth = static_cast<unsigned int>(std::stoul(arg));
+		if (opt::iodepth == 0) {
+			std::cout << "Invalid iodepth " << opt::iodepth
+				<< std::endl;
+			return -1;
+		}
+	} else if (name == "write_data") {
+		// optional parameter follows type, e.g. compress:2
+		auto pos = arg.find(':');
+		auto type = arg.substr(0, pos);
+		auto param = pos == std::string::npos ? std::string() :
+			arg.substr(pos + 1);
+		if (type == "zero" && param.empty()) {
+			opt::write_data = WriteData::Zero;
+		} else if (type == "pattern" && param.empty()) {
+			opt::write_data = WriteData::Pattern;
+		} else if (type == "random" && param.empty()) {
+			opt::write_data = WriteData::Random;
+		} else if (type == "compress") {
+			opt::write_data = WriteData::Compress;
+			if (!param.empty())
+				opt::write_data_compress = std::stod(param);
+			if (opt::write_data_compress < 1) {
+				std::cout << "Invalid compress ratio "
+					<< opt::write_data_compress << std::endl;
+				return -1;
+			}
+		} else if (type == "dedup") {
+			opt::write_data = WriteData::Dedup;
+			if (!param.empty())
+				opt::write_data_dedup = std::stod(param);
+			if (opt::write_data_dedup < 0 ||
+				opt::write_data_dedup > 100) {
+				std::cout << "Invalid dedup percentage "
+					<< opt::write_data_dedup << std::endl;
+				return -1;
+			}
+		} else {
+			std::cout << "Invalid write data " << arg << std::endl;
 			return -1;
 		}
 	} else if (name == "random_write_data") {
-		opt::random_write_data = true;
+		opt::write_data = WriteData::Random;
 	} else if (name == "num_write_paths") {
 		opt::num_write_paths = std::stol(arg);
 		if (opt::num_write_paths < -1)
 			opt::num_write_paths = -1;
 	} else if (name == "truncate_write_paths") {
 		opt::truncate_write_paths = true;
+	} else if (name == "write_alloc") {
+		if (arg == "none") {
+			opt::write_alloc = WriteAlloc::None;
+		} else if (arg == "fallocate" || arg == "zero_range" ||
+			arg == "punch_hole" || arg == "collapse") {
+			if (!is_linux()) {
+				std::cout << arg << " unsupported" << std::endl;
+				return -1;
+			}
+			if (arg == "fallocate")
+				opt::write_alloc = WriteAlloc::Fallocate;
+			else if (arg == "zero_range")
+				opt::write_alloc = WriteAlloc::ZeroRange;
+			else if (arg == "punch_hole")
+				opt::write_alloc = WriteAlloc::PunchHole;
+			else
+				opt::write_alloc = WriteAlloc::Collapse;
+		} else {
+			std::cout << "Invalid write alloc " << arg << std::endl;
+			return -1;
+		}
+	} else if (name == "write_target") {
+		if (arg == "new") {
+			opt::write_target = WriteTarget::New;
+		} else if (arg == "overwrite") {
+			opt::write_target = WriteTarget::Overwrite;
+		} else if (arg == "append") {
+			opt::write_target = WriteTarget::Append;
+		} else {
+			std::cout << "Invalid write target " << arg << std::endl;
+			return -1;
+		}
 	} else if (name == "fsync_write_paths") {
 		opt::fsync_write_paths = true;
 	} else if (name == "dirsync_write_paths") {
 		opt::dirsync_write_paths = true;
+	} else if (name == "sync_batch") {
+		opt::sync_batch = std::stoul(arg);
+	} else if (name == "sync_batch_ms") {
+		opt::sync_batch_ms = std::stoul(arg);
+	} else if (name == "sync_method") {
+		if (arg == "fsync") {
+			opt::sync_method = SyncMethod::Fsync;
+		} else if (arg == "syncfs" || arg == "writebehind") {
+			if (!is_linux()) {
+				std::cout << arg << " unsupported" << std::endl;
+				return -1;
+			}
+			if (arg == "syncfs")
+				opt::sync_method = SyncMethod::Syncfs;
+			else
+				opt::sync_method = SyncMethod::Writebehind;
+		} else {
+			std::cout << "Invalid sync method " << arg << std::endl;
+			return -1;
+		}
 	} else if (name == "keep_write_paths") {
 		opt::keep_write_paths = true;
 	} else if (name == "clean_write_paths") {
@@ -279,7 +572,47 @@ int handle_long_option(const std::string& name, const std::string& arg) {
 			}
 		}
 	} else if (name == "path_iter") {
-		if (arg == "walk") {
+		// optional parameters follow type, e.g. zipf:0.99
+		std::vector<std::string> v;
+		std::stringstream ss(arg);
+		std::string x;
+		while (std::getline(ss, x, ':'))
+			v.push_back(x);
+		if (v.empty())
+			v.push_back("");
+		if (v[0] == "zipf" && v.size() <= 2) {
+			opt::path_iter = PathIter::Zipf;
+			if (v.size() > 1)
+				opt::zipf_theta = std::stod(v[1]);
+			if (opt::zipf_theta < 0) {
+				std::cout << "Invalid zipf theta "
+					<< opt::zipf_theta << std::endl;
+				return -1;
+			}
+		} else if (v[0] == "hotspot" && v.size() <= 3) {
+			opt::path_iter = PathIter::Hotspot;
+			if (v.size() > 1)
+				opt::hotspot_files = std::stod(v[1]);
+			if (v.size() > 2)
+				opt::hotspot_ops = std::stod(v[2]);
+			if (opt::hotspot_files <= 0 ||
+				opt::hotspot_files > 100 ||
+				opt::hotspot_ops < 0 || opt::hotspot_ops > 100) {
+				std::cout << "Invalid hotspot "
+					<< opt::hotspot_files << ":"
+					<< opt::hotspot_ops << std::endl;
+				return -1;
+			}
+		} else if (v[0] == "gaussian" && v.size() <= 2) {
+			opt::path_iter = PathIter::Gaussian;
+			if (v.size() > 1)
+				opt::gaussian_stddev = std::stod(v[1]);
+			if (opt::gaussian_stddev <= 0) {
+				std::cout << "Invalid gaussian stddev "
+					<< opt::gaussian_stddev << std::endl;
+				return -1;
+			}
+		} else if (arg == "walk") {
 			opt::path_iter = PathIter::Walk;
 		} else if (arg == "ordered") {
 			opt::path_iter = PathIter::Ordered;
@@ -292,10 +625,43 @@ int handle_long_option(const std::string& name, const std::string& arg) {
 				<< std::endl;
 			return -1;
 		}
+	} else if (name == "shard") {
+		if (arg == "none") {
+			opt::shard = Shard::None;
+		} else if (arg == "contiguous") {
+			opt::shard = Shard::Contiguous;
+		} else if (arg == "interleaved") {
+			opt::shard = Shard::Interleaved;
+		} else if (arg == "dynamic") {
+			opt::shard = Shard::Dynamic;
+		} else {
+			std::cout << "Invalid shard type " << arg << std::endl;
+			return -1;
+		}
 	} else if (name == "flist_file") {
 		opt::flist_file = arg;
 	} else if (name == "flist_file_create") {
 		opt::flist_file_create = true;
+	} else if (name == "flist_file_format") {
+		if (arg == "text") {
+			opt::flist_file_format = FlistFormat::Text;
+		} else if (arg == "binary") {
+			opt::flist_file_format = FlistFormat::Binary;
+		} else {
+			std::cout << "Invalid flist file format " << arg
+				<< std::endl;
+			return -1;
+		}
+	} else if (name == "flist_cached_stat") {
+		opt::flist_cached_stat = true;
+	} else if (name == "flist_compress") {
+		opt::flist_compress = true;
+	} else if (name == "flist_stream") {
+		opt::flist_stream = true;
+	} else if (name == "num_scanner") {
+		opt::num_scanner = static_cast<unsigned int>(std::stoul(arg));
+	} else if (name == "seed") {
+		opt::seed = std::stol(arg);
 	} else if (name == "force") {
 		opt::force = true;
 	} else if (name == "verbose") {
@@ -334,20 +700,42 @@ int main(int argc, char** argv) {
 		{ "follow_symlink", 0, nullptr, 0 },
 		{ "read_buffer_size", 1, nullptr, 0 },
 		{ "read_size", 1, nullptr, 0 },
+		{ "read_engine", 1, nullptr, 0 },
+		{ "madvise", 1, nullptr, 0 },
+		{ "read_pattern", 1, nullptr, 0 },
+		{ "read_block_size", 1, nullptr, 0 },
+		{ "read_ops", 1, nullptr, 0 },
 		{ "write_buffer_size", 1, nullptr, 0 },
 		{ "write_size", 1, nullptr, 0 },
+		{ "write_file_size", 1, nullptr, 0 },
+		{ "write_engine", 1, nullptr, 0 },
+		{ "buffer_type", 1, nullptr, 0 },
+		{ "iodepth", 1, nullptr, 0 },
+		{ "write_data", 1, nullptr, 0 },
 		{ "random_write_data", 0, nullptr, 0 },
 		{ "num_write_paths", 1, nullptr, 0 },
 		{ "truncate_write_paths", 0, nullptr, 0 },
+		{ "write_alloc", 1, nullptr, 0 },
+		{ "write_target", 1, nullptr, 0 },
 		{ "fsync_write_paths", 0, nullptr, 0 },
 		{ "dirsync_write_paths", 0, nullptr, 0 },
+		{ "sync_batch", 1, nullptr, 0 },
+		{ "sync_batch_ms", 1, nullptr, 0 },
+		{ "sync_method", 1, nullptr, 0 },
 		{ "keep_write_paths", 0, nullptr, 0 },
 		{ "clean_write_paths", 0, nullptr, 0 },
 		{ "write_paths_base", 1, nullptr, 0 },
 		{ "write_paths_type", 1, nullptr, 0 },
 		{ "path_iter", 1, nullptr, 0 },
+		{ "shard", 1, nullptr, 0 },
 		{ "flist_file", 1, nullptr, 0 },
 		{ "flist_file_create", 0, nullptr, 0 },
+		{ "flist_file_format", 1, nullptr, 0 },
+		{ "flist_cached_stat", 0, nullptr, 0 },
+		{ "flist_compress", 0, nullptr, 0 },
+		{ "flist_stream", 0, nullptr, 0 },
+		{ "num_scanner", 1, nullptr, 0 },
+		{ "seed", 1, nullptr, 0 },
 		{ "force", 0, nullptr, 0 },
 		{ "verbose", 0, nullptr, 0 },
 		{ "debug", 0, nullptr, 0 },
@@ -399,12 +787,139 @@ int main(int argc, char** argv) {
 		opt::path_iter = PathIter::Ordered;
 		std::cout << "Using flist, force --path_iter=ordered" << std::endl;
 	}
+	// walk has no flist to shard
+	if (opt::shard != Shard::None && opt::path_iter == PathIter::Walk) {
+		std::cout << "Shard requires flist, not walk" << std::endl;
+		exit(1);
+	}
+	// streamed flist is only available in order
+	if (opt::flist_stream) {
+		if (opt::flist_file.empty()) {
+			std::cout << "Flist stream requires flist file"
+				<< std::endl;
+			exit(1);
+		}
+		if (opt::flist_file_create) {
+			std::cout << "Flist stream can't be used to create flist"
+				<< std::endl;
+			exit(1);
+		}
+		if (opt::path_iter != PathIter::Ordered) {
+			std::cout << "Flist stream requires ordered path "
+				<< "iteration" << std::endl;
+			exit(1);
+		}
+		if (opt::flist_compress) {
+			std::cout << "Flist stream can't be compressed"
+				<< std::endl;
+			exit(1);
+		}
+		if (opt::shard != Shard::None) {
+			std::cout << "Flist stream can't be sharded"
+				<< std::endl;
+			exit(1);
+		}
+	}
+	// O_DIRECT requires page aligned read size
+	if (opt::read_engine == ReadEngine::Direct &&
+		opt::read_buffer_size % get_page_size()) {
+		std::cout << "Read buffer size " << opt::read_buffer_size
+			<< " not aligned to " << get_page_size() << std::endl;
+		exit(1);
+	}
+	// O_DIRECT requires page aligned write size
+	if (opt::write_engine == WriteEngine::Direct &&
+		opt::write_buffer_size % get_page_size()) {
+		std::cout << "Write buffer size " << opt::write_buffer_size
+			<< " not aligned to " << get_page_size() << std::endl;
+		exit(1);
+	}
+	// fallocate(2) is issued on fd of the write engine
+	if (opt::write_alloc != WriteAlloc::None &&
+		opt::write_engine != WriteEngine::Psync &&
+		opt::write_engine != WriteEngine::Direct &&
+		opt::write_engine != WriteEngine::Dsync) {
+		std::cout << "Write alloc requires psync, direct or dsync "
+			<< "write engine" << std::endl;
+		exit(1);
+	}
+	// existing files are written via fd of the write engine
+	if (opt::write_target != WriteTarget::New) {
+		if (opt::write_engine != WriteEngine::Psync &&
+			opt::write_engine != WriteEngine::Direct &&
+			opt::write_engine != WriteEngine::Dsync) {
+			std::cout << "Write target requires psync, direct or "
+				<< "dsync write engine" << std::endl;
+			exit(1);
+		}
+		if (opt::write_target == WriteTarget::Append &&
+			opt::write_engine == WriteEngine::Direct) {
+			std::cout << "Append can't use direct write engine"
+				<< std::endl;
+			exit(1);
+		}
+		if (opt::write_alloc != WriteAlloc::None ||
+			opt::truncate_write_paths) {
+			std::cout << "Write alloc and truncate require new "
+				<< "write target" << std::endl;
+			exit(1);
+		}
+	}
+	// batch is committed by worker threads, not by io_uring
+	if (opt::sync_batch > 0 || opt::sync_batch_ms > 0) {
+		if (!opt::fsync_write_paths && !opt::dirsync_write_paths) {
+			std::cout << "Sync batch requires fsync or dirsync "
+				<< "write paths" << std::endl;
+			exit(1);
+		}
+		if (opt::write_engine == WriteEngine::Uring) {
+			std::cout << "Sync batch can't use uring write engine"
+				<< std::endl;
+			exit(1);
+		}
+	} else if (opt::sync_method != SyncMethod::Fsync) {
+		std::cout << "Sync method requires sync batch" << std::endl;
+		exit(1);
+	}
+	if (opt::sync_method == SyncMethod::Writebehind &&
+		opt::write_engine != WriteEngine::Psync &&
+		opt::write_engine != WriteEngine::Direct &&
+		opt::write_engine != WriteEngine::Dsync) {
+		std::cout << "Write-behind requires psync, direct or dsync "
+			<< "write engine" << std::endl;
+		exit(1);
+	}
+	// random or strided reads use pread(2) with block size <= buffer
+	if (opt::read_pattern != ReadPattern::Seq) {
+		if (opt::read_engine != ReadEngine::Psync &&
+			opt::read_engine != ReadEngine::Direct) {
+			std::cout << "Read pattern requires psync or direct "
+				<< "read engine" << std::endl;
+			exit(1);
+		}
+		if (opt::read_block_size > opt::read_buffer_size) {
+			std::cout << "Read block size " << opt::read_block_size
+				<< " > read buffer size "
+				<< opt::read_buffer_size << std::endl;
+			exit(1);
+		}
+		if (opt::read_engine == ReadEngine::Direct &&
+			opt::read_block_size % get_page_size()) {
+			std::cout << "Read block size " << opt::read_block_size
+				<< " not aligned to " << get_page_size()
+				<< std::endl;
+			exit(1);
+		}
+	}
 
 	if (is_windows()) {
 		std::cout << "Windows unsupported" << std::endl;
 		exit(1);
 	}
 
+	// worker threads seed their own engines with gid
+	init_random_engine(opt::seed, 0);
+
 	auto s = get_path_separator();
 	if (s != '/') {
 		std::cout << "Invalid path separator " << s << std::endl;
@@ -457,7 +972,8 @@ int main(int argc, char** argv) {
 			exit(1);
 		}
 		auto ret = create_flist_file(input, opt::flist_file,
-			opt::ignore_dot, opt::force);
+			opt::ignore_dot, opt::force, opt::num_scanner,
+			opt::flist_file_format);
 		if (ret < 0) {
 			std::cout << strerror(-ret) << std::endl;
 			exit(1);
@@ -467,19 +983,16 @@ int main(int argc, char** argv) {
 	}
 	// clean write paths and exit
 	if (opt::clean_write_paths) {
-		auto l = collect_write_paths(input);
-		auto a = l.size();
-		auto ret = unlink_write_paths(l, -1);
+		std::vector<std::string> l;
+		UnlinkStat us{};
+		auto ret = clean_write_paths(input, l, us);
 		if (ret < 0) {
 			std::cout << strerror(-ret) << std::endl;
 			exit(1);
 		}
-		auto b = l.size();
-		assert(a >= b);
-		std::cout << "Unlinked " << (a - b) << " / " << a
-			<< " write paths" << std::endl;
-		if (b != 0) {
-			std::cout << b << " / " << a << " write paths remaining"
+		print_unlink_stat(us);
+		if (!l.empty()) {
+			std::cout << l.size() << " write paths remaining"
 				<< std::endl;
 			exit(1);
 		}
@@ -521,7 +1034,7 @@ int main(int argc, char** argv) {
 				exit(1);
 			}
 			auto [_ignore, num_interrupted, num_error, num_remain,
-				tsv] = result;
+				tsv, us] = result;
 			if (num_interrupted > 0)
 				std::cout << num_interrupted << " worker"
 					<< (num_interrupted > 1 ? "s" : "")
@@ -535,6 +1048,7 @@ int main(int argc, char** argv) {
 					<< (num_remain > 1 ? "s" : "")
 					<< " remaining" << std::endl;
 			print_stat(tsv);
+			print_unlink_stat(us);
 			if (num_interrupted > 0)
 				break;
 		} catch (const std::exception& e) {
@@ -0,0 +1,287 @@
+#include <deque>
+#include <tuple>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "./log.h"
+#include "./scan.h"
+#include "./thread.h"
+#include "./util.h"
+#include "./walk.h"
+
+namespace {
+struct ScanWork {
+	std::string path;
+	size_t index; // index of input directory
+};
+
+// owner pops newest (depth first), thieves steal oldest
+// which is usually closer to the root and has more work beneath
+class ScanQueue {
+	public:
+	void push(ScanWork&& w) {
+		_mutex.lock();
+		_q.push_back(std::move(w));
+		_mutex.unlock();
+	}
+	bool pop(ScanWork& w) {
+		_mutex.lock();
+		auto ret = !_q.empty();
+		if (ret) {
+			w = std::move(_q.back());
+			_q.pop_back();
+		}
+		_mutex.unlock();
+		return ret;
+	}
+	bool steal(ScanWork& w) {
+		if (!_mutex.try_lock())
+			return false;
+		auto ret = !_q.empty();
+		if (ret) {
+			w = std::move(_q.front());
+			_q.pop_front();
+		}
+		_mutex.unlock();
+		return ret;
+	}
+
+	private:
+	Mutex _mutex;
+	std::deque<ScanWork> _q;
+};
+
+class Scanner {
+	public:
+	Scanner(const std::vector<std::string>&, bool, bool, unsigned int,
+		const std::string& = "");
+	Scanner(const Scanner&) = delete;
+	Scanner& operator=(const Scanner&) = delete;
+
+	int run(std::vector<std::vector<ScanEntry>>&);
+	void scan(unsigned int);
+	unsigned long get_num_unlinked(void) const {
+		return _num_unlinked;
+	}
+
+	private:
+	bool get_work(unsigned int, ScanWork&);
+	int scan_dir(Walker&, const ScanWork&, unsigned int);
+	void unlink_entry(Walker&, const std::string&, FileType,
+		std::vector<ScanEntry>&);
+
+	const std::vector<std::string>& _input;
+	bool _ignore_dot;
+	bool _stat;
+	unsigned int _num_thread;
+	std::string _unlink_prefix; // unlink matched entries if not empty
+	std::atomic<unsigned long> _num_unlinked;
+	std::vector<ScanQueue> _queues;
+	// per thread flists of each input, merged after join
+	std::vector<std::vector<std::vector<ScanEntry>>> _results;
+	std::atomic<unsigned long> _pending; // queued or being scanned
+	std::atomic<int> _error;
+};
+
+typedef std::tuple<Scanner*, unsigned int> thread_scanner_arg;
+
+Scanner::Scanner(const std::vector<std::string>& input, bool ignore_dot,
+	bool stat, unsigned int num_thread, const std::string& unlink_prefix):
+	_input(input),
+	_ignore_dot(ignore_dot),
+	_stat(stat),
+	_num_thread(num_thread),
+	_unlink_prefix(unlink_prefix),
+	_num_unlinked(0),
+	_queues(num_thread),
+	_results(num_thread),
+	_pending(0),
+	_error(0) {
+	assert(_num_thread > 0);
+	for (auto& v : _results)
+		v.resize(_input.size());
+}
+
+bool Scanner::get_work(unsigned int id, ScanWork& w) {
+	if (_queues[id].pop(w))
+		return true;
+	for (unsigned int i = 1; i < _num_thread; i++)
+		if (_queues[(id + i) % _num_thread].steal(w))
+			return true;
+	return false;
+}
+
+// matched on raw name, directories are left until their entries are gone
+void Scanner::unlink_entry(Walker& walker, const std::string& f,
+	FileType t, std::vector<ScanEntry>& l) {
+	auto name = f.c_str() + f.rfind('/') + 1;
+	if (strncmp(name, _unlink_prefix.c_str(), _unlink_prefix.size()))
+		return;
+	switch (t) {
+	case FileType::Dir:
+		l.push_back({f, t, -1});
+		break;
+	case FileType::Reg:
+		[[fallthrough]];
+	case FileType::Symlink:
+		// don't resolve symlink (unlink symlink itself, not target)
+		if (unlinkat(walker.get_dirfd(), name, 0) == 0)
+			_num_unlinked++;
+		else if (errno != ENOENT)
+			l.push_back({f, t, -1});
+		break;
+	default:
+		break;
+	}
+}
+
+int Scanner::scan_dir(Walker& walker, const ScanWork& w, unsigned int id) {
+	auto& l = _results[id][w.index];
+	return walker.walk(w.path, [&](const std::string& f, FileType t) {
+		if (!_unlink_prefix.empty())
+			unlink_entry(walker, f, t, l);
+		if (t == FileType::Dir) {
+			_pending++;
+			_queues[id].push({f, w.index});
+			return 0;
+		}
+		if (!_unlink_prefix.empty())
+			return 0;
+		// ignore . entries if specified
+		if (_ignore_dot && is_dot_path(f))
+			return 0;
+		if (t != FileType::Reg && t != FileType::Symlink)
+			return 0;
+		off_t size = -1;
+		if (_stat) {
+			struct stat st;
+			auto name = f.c_str() + f.rfind('/') + 1;
+			if (fstatat(walker.get_dirfd(), name, &st,
+				AT_SYMLINK_NOFOLLOW) == 0 &&
+				get_mode_file_type(st.st_mode) == t)
+				size = st.st_size;
+		}
+		l.push_back({f, t, size});
+		return 0;
+	}, false);
+}
+
+void Scanner::scan(unsigned int id) {
+	Walker walker;
+	while (_error == 0) {
+		ScanWork w;
+		if (get_work(id, w)) {
+			auto ret = scan_dir(walker, w, id);
+			if (ret < 0) {
+				xlog("scanner %u %s failed %d", id,
+					w.path.c_str(), ret);
+				auto expected = 0;
+				_error.compare_exchange_strong(expected, ret);
+			}
+			_pending--;
+		} else if (_pending == 0) {
+			break;
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+EXTERN_C_BEGIN
+void* scanner_handler(void* arg) {
+	auto [scanner, id] = *reinterpret_cast<thread_scanner_arg*>(arg);
+	scanner->scan(id);
+	return nullptr;
+}
+EXTERN_C_END
+
+int Scanner::run(std::vector<std::vector<ScanEntry>>& fls) {
+	for (size_t i = 0; i < _input.size(); i++) {
+		_pending++;
+		_queues[i % _num_thread].push({_input[i], i});
+	}
+
+	std::vector<Thread> thrv(_num_thread);
+	std::vector<thread_scanner_arg> argv;
+	for (unsigned int i = 0; i < _num_thread; i++)
+		argv.push_back({this, i});
+	for (unsigned int i = 0; i < _num_thread; i++) {
+		auto ret = thrv[i].create(scanner_handler, &argv[i]);
+		if (ret) {
+			xlog("scanner %u create failed %d", i, ret);
+			// let created ones exit
+			auto expected = 0;
+			_error.compare_exchange_strong(expected, -ret);
+			for (unsigned int j = 0; j < i; j++)
+				thrv[j].join();
+			return -ret;
+		}
+	}
+	for (unsigned int i = 0; i < _num_thread; i++) {
+		auto ret = thrv[i].join();
+		if (ret) {
+			xlog("scanner %u join failed %d", i, ret);
+			return -ret;
+		}
+	}
+	if (_error < 0)
+		return _error;
+
+	fls.clear();
+	fls.resize(_input.size());
+	for (size_t i = 0; i < _input.size(); i++) {
+		size_t n = 0;
+		for (const auto& v : _results)
+			n += v[i].size();
+		auto& fl = fls[i];
+		fl.reserve(n);
+		for (auto& v : _results) {
+			std::move(v[i].begin(), v[i].end(),
+				std::back_inserter(fl));
+			v[i].clear();
+		}
+		std::sort(fl.begin(), fl.end(),
+			[](const ScanEntry& a, const ScanEntry& b) {
+				return a.path < b.path;
+			});
+	}
+	return 0;
+}
+} // namespace
+
+int scan_flist(const std::vector<std::string>& input, bool ignore_dot,
+	bool stat, unsigned int num_thread,
+	std::vector<std::vector<ScanEntry>>& fls) {
+	if (num_thread == 0)
+		num_thread = get_num_cpus();
+	Scanner scanner(input, ignore_dot, stat, num_thread);
+	return scanner.run(fls);
+}
+
+int scan_unlink(const std::vector<std::string>& input,
+	const std::string& prefix, unsigned int num_thread,
+	std::vector<std::string>& l, unsigned long& num_unlinked) {
+	assert(!prefix.empty());
+	if (num_thread == 0)
+		num_thread = get_num_cpus();
+	Scanner scanner(input, false, false, num_thread, prefix);
+	std::vector<std::vector<ScanEntry>> fls;
+	auto ret = scanner.run(fls);
+	num_unlinked = scanner.get_num_unlinked();
+	if (ret < 0)
+		return ret;
+	for (auto& fl : fls)
+		for (auto& x : fl)
+			l.push_back(std::move(x.path));
+	return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef SRC_SCAN_H_
+#define SRC_SCAN_H_
+
+#include <vector>
+#include <string>
+
+#include <sys/types.h>
+
+#include "./util.h"
+
+struct ScanEntry {
+	std::string path;
+	FileType type;
+	off_t size; // -1 unless scanned with stat
+};
+
+// scans input directories in parallel, flist per input is sorted
+int scan_flist(const std::vector<std::string>&, bool, bool, unsigned int,
+	std::vector<std::vector<ScanEntry>>&);
+// scans input directories in parallel and unlinks entries whose names
+// start with the prefix, matched directories and entries failed to unlink
+// are returned for the caller to unlink
+int scan_unlink(const std::vector<std::string>&, const std::string&,
+	unsigned int, std::vector<std::string>&, unsigned long&);
+#endif // SRC_SCAN_H_
@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <sstream>
 #include <array>
+#include <tuple>
 
 #include <cassert>
 
@@ -18,6 +19,7 @@ ThreadStat::ThreadStat(bool is_reader):
 	_num_read_bytes(0),
 	_num_write(0),
 	_num_write_bytes(0),
+	_sync_latency{},
 	_done(false) {
 }
 
@@ -27,6 +29,11 @@ bool ThreadStat::sec_elapsed(long d) const {
 	return time_elapsed<std::chrono::seconds>().count() > d;
 }
 
+namespace {
+void print_sync_latency(const std::vector<const ThreadStat*>&,
+	unsigned long);
+} // namespace
+
 void print_stat(const std::vector<ThreadStat>& tsv) {
 	std::vector<const ThreadStat*> v;
 	for (const auto& ts : tsv)
@@ -216,9 +223,66 @@ void print_stat(const std::vector<const ThreadStat*>& tsv) {
 			<< p->get_input_path() << " ";
 		std::cout << std::endl;
 	}
+	print_sync_latency(tsv, width_index);
 	std::cout << std::flush;
 }
 
+// only printed if any write path was unlinked
+void print_unlink_stat(const UnlinkStat& us) {
+	if (us.num_unlinked == 0)
+		return;
+	std::cout << std::endl;
+	std::cout << "Unlinked " << us.num_unlinked << " write paths in "
+		<< std::fixed << std::setprecision(2) << us.sec << " sec, "
+		<< (us.sec > 0 ?
+		static_cast<double>(us.num_unlinked) / us.sec : 0)
+		<< " paths/sec" << std::defaultfloat << std::endl;
+}
+
+namespace {
+// only printed if any durability operation was measured
+void print_sync_latency(const std::vector<const ThreadStat*>& tsv,
+	unsigned long width_index) {
+	const std::array<std::tuple<SyncClass, std::string>, 3> cl{{
+		{SyncClass::File, "file"},
+		{SyncClass::Dir, "dir"},
+		{SyncClass::Batch, "batch"},
+	}};
+	auto found = false;
+	for (const auto& ts : tsv)
+		for (const auto& [c, s] : cl)
+			if (ts->get_sync_latency(c).count > 0)
+				found = true;
+	if (!found)
+		return;
+
+	std::cout << std::endl;
+	std::cout << std::string(1 + width_index + 1, ' ') << std::left
+		<< std::setw(6) << "sync" << " " << std::right
+		<< std::setw(10) << "count" << " "
+		<< std::setw(12) << "avg[usec]" << " "
+		<< std::setw(12) << "max[usec]" << std::endl;
+	for (size_t i = 0; i < tsv.size(); i++)
+		for (const auto& [c, s] : cl) {
+			const auto& l = tsv[i]->get_sync_latency(c);
+			if (l.count == 0)
+				continue;
+			std::ostringstream avg, max;
+			avg << std::fixed << std::setprecision(1)
+				<< static_cast<double>(l.total_ns) / 1000 /
+				static_cast<double>(l.count);
+			max << std::fixed << std::setprecision(1)
+				<< static_cast<double>(l.max_ns) / 1000;
+			std::cout << "#" << std::left
+				<< std::setw(static_cast<int>(width_index))
+				<< i << " " << std::setw(6) << s << " "
+				<< std::right << std::setw(10) << l.count << " "
+				<< std::setw(12) << avg.str() << " "
+				<< std::setw(12) << max.str() << std::endl;
+		}
+}
+} // namespace
+
 #ifdef CONFIG_CPPUNIT
 #include <thread>
 
@@ -348,5 +412,22 @@ void StatTest::test_add_num_write_bytes(void) {
 	CPPUNIT_ASSERT_EQUAL(ts.get_num_write_bytes(), siz * 2);
 }
 
+void StatTest::test_add_sync_latency(void) {
+	auto ts = ThreadStat::newwrite();
+	for (auto c : {SyncClass::File, SyncClass::Dir, SyncClass::Batch}) {
+		const auto& l = ts.get_sync_latency(c);
+		CPPUNIT_ASSERT_EQUAL(l.count, 0lu);
+		CPPUNIT_ASSERT_EQUAL(l.total_ns, 0lu);
+		CPPUNIT_ASSERT_EQUAL(l.max_ns, 0lu);
+	}
+	ts.add_sync_latency(SyncClass::Dir, std::chrono::nanoseconds(300));
+	ts.add_sync_latency(SyncClass::Dir, std::chrono::nanoseconds(100));
+	const auto& l = ts.get_sync_latency(SyncClass::Dir);
+	CPPUNIT_ASSERT_EQUAL(l.count, 2lu);
+	CPPUNIT_ASSERT_EQUAL(l.total_ns, 400lu);
+	CPPUNIT_ASSERT_EQUAL(l.max_ns, 300lu);
+	CPPUNIT_ASSERT_EQUAL(ts.get_sync_latency(SyncClass::File).count, 0lu);
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(StatTest);
 #endif
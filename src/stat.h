@@ -5,6 +5,25 @@
 #include <string>
 #include <chrono>
 
+// latency classes of durability operations
+enum class SyncClass {
+	File, // fsync(2), or write-behind wait and fdatasync(2)
+	Dir, // fsync(2) of a parent directory
+	Batch, // commit of a batch, including File and Dir in it
+};
+
+struct Latency {
+	unsigned long count;
+	unsigned long total_ns;
+	unsigned long max_ns;
+};
+
+// unlink of write paths after workers exit or for --clean_write_paths
+struct UnlinkStat {
+	unsigned long num_unlinked;
+	double sec;
+};
+
 class ThreadStat {
 	public:
 	explicit ThreadStat(bool);
@@ -49,6 +68,9 @@ class ThreadStat {
 	unsigned long get_num_write_bytes(void) const {
 		return _num_write_bytes;
 	}
+	const Latency& get_sync_latency(SyncClass c) const {
+		return _sync_latency[static_cast<int>(c)];
+	}
 	bool is_done(void) const {
 		return _done;
 	}
@@ -80,6 +102,14 @@ class ThreadStat {
 	void add_num_write_bytes(unsigned long siz) {
 		_num_write_bytes += siz;
 	}
+	void add_sync_latency(SyncClass c, std::chrono::nanoseconds d) {
+		auto& l = _sync_latency[static_cast<int>(c)];
+		auto ns = static_cast<unsigned long>(d.count());
+		l.count++;
+		l.total_ns += ns;
+		if (ns > l.max_ns)
+			l.max_ns = ns;
+	}
 	void set_done(void) {
 		_done = true;
 	}
@@ -104,11 +134,13 @@ class ThreadStat {
 	unsigned long _num_read_bytes;
 	unsigned long _num_write;
 	unsigned long _num_write_bytes;
+	Latency _sync_latency[3];
 	bool _done;
 };
 
 void print_stat(const std::vector<ThreadStat>&);
 void print_stat(const std::vector<const ThreadStat*>&);
+void print_unlink_stat(const UnlinkStat&);
 
 #ifdef CONFIG_CPPUNIT
 #include <cppunit/TestFixture.h>
@@ -128,6 +160,7 @@ class StatTest: public CPPUNIT_NS::TestFixture {
 	CPPUNIT_TEST(test_add_num_read_bytes);
 	CPPUNIT_TEST(test_inc_num_write);
 	CPPUNIT_TEST(test_add_num_write_bytes);
+	CPPUNIT_TEST(test_add_sync_latency);
 	CPPUNIT_TEST_SUITE_END();
 
 	private:
@@ -141,6 +174,7 @@ class StatTest: public CPPUNIT_NS::TestFixture {
 	void test_add_num_read_bytes(void);
 	void test_inc_num_write(void);
 	void test_add_num_write_bytes(void);
+	void test_add_sync_latency(void);
 };
 #endif
 #endif // SRC_STAT_H_
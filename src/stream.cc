@@ -0,0 +1,217 @@
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <utility>
+
+#include <cerrno>
+#include <cassert>
+
+#include "./global.h"
+#include "./log.h"
+#include "./stream.h"
+
+ChunkQueue::ChunkQueue(size_t depth):
+	_mutex{},
+	_cond{},
+	_q{},
+	_depth(depth),
+	_closed(false),
+	_finished(false),
+	_error(0) {
+	assert(_depth > 0);
+}
+
+// blocks while full, returns false if closed by consumer
+bool ChunkQueue::push(std::shared_ptr<const Flist> chunk) {
+	_mutex.lock();
+	while (!_closed && _q.size() >= _depth)
+		_cond.wait(_mutex);
+	auto ret = !_closed;
+	if (ret) {
+		_q.push_back(std::move(chunk));
+		_cond.broadcast();
+	}
+	_mutex.unlock();
+	return ret;
+}
+
+// blocks while empty, returns 1 for chunk, 0 for end of pass
+int ChunkQueue::pop(std::shared_ptr<const Flist>& chunk) {
+	_mutex.lock();
+	while (_q.empty() && !_finished)
+		_cond.wait(_mutex);
+	int ret;
+	if (!_q.empty()) {
+		chunk = std::move(_q.front());
+		_q.pop_front();
+		_cond.broadcast();
+		ret = chunk ? 1 : 0;
+	} else {
+		// producer never finishes while consumer is open unless error
+		ret = _error < 0 ? _error : -EPIPE;
+	}
+	_mutex.unlock();
+	return ret;
+}
+
+void ChunkQueue::close(void) {
+	_mutex.lock();
+	_closed = true;
+	_q.clear();
+	_cond.broadcast();
+	_mutex.unlock();
+}
+
+void ChunkQueue::finish(int error) {
+	_mutex.lock();
+	_finished = true;
+	_error = error;
+	_cond.broadcast();
+	_mutex.unlock();
+}
+
+bool ChunkQueue::is_closed(void) {
+	_mutex.lock();
+	auto ret = _closed;
+	_mutex.unlock();
+	return ret;
+}
+
+namespace {
+EXTERN_C_BEGIN
+void* stream_handler(void* arg) {
+	reinterpret_cast<FlistStream*>(arg)->produce();
+	return nullptr;
+}
+EXTERN_C_END
+} // namespace
+
+FlistStream::FlistStream(const std::string& flist_file,
+	const std::vector<std::string>& input):
+	_flist_file(flist_file),
+	_input(input),
+	_matcher(input),
+	_queues{},
+	_queue_input{},
+	_thread{} {
+}
+
+ChunkQueue* FlistStream::add_consumer(size_t index) {
+	assert(index < _input.size());
+	_queues.push_back(std::make_unique<ChunkQueue>(FLIST_QUEUE_DEPTH));
+	_queue_input.push_back(index);
+	return _queues.back().get();
+}
+
+int FlistStream::start(void) {
+	return _thread.create(stream_handler, this);
+}
+
+int FlistStream::join(void) {
+	return _thread.join();
+}
+
+bool FlistStream::is_all_closed(void) {
+	for (const auto& q : _queues)
+		if (!q->is_closed())
+			return false;
+	return true;
+}
+
+// chunk is shared by consumers of the input, returns false if all closed
+bool FlistStream::publish(size_t index, std::shared_ptr<PathTable>& chunk) {
+	std::shared_ptr<const Flist> x = std::move(chunk);
+	for (size_t i = 0; i < _queues.size(); i++)
+		if (_queue_input[i] == index)
+			_queues[i]->push(x);
+	return !is_all_closed();
+}
+
+// returns > 0 if all consumers are closed
+int FlistStream::produce_pass(unsigned long pass, const Flist* fl) {
+	std::vector<std::shared_ptr<PathTable>> chunks(_input.size());
+	std::vector<unsigned long> counts(_input.size());
+	auto add = [&](std::string_view s) {
+		auto closed = false;
+		// s can exist in multiple inputs
+		auto n = _matcher.match(s, [&](size_t i) {
+			auto& chunk = chunks[i];
+			if (!chunk) {
+				chunk = std::make_shared<PathTable>();
+				chunk->reserve(FLIST_CHUNK_SIZE, 0);
+			}
+			chunk->push_back(s);
+			counts[i]++;
+			if (chunk->size() == FLIST_CHUNK_SIZE &&
+				!publish(i, chunk))
+				closed = true;
+		});
+		if (closed)
+			return 1;
+		if (n == 0) {
+			std::cout << s << " has no prefix in "
+				<< join_input(_input) << std::endl;
+			return -EINVAL;
+		}
+		return 0;
+	};
+
+	auto ret = 0;
+	if (fl) {
+		std::string buf;
+		for (size_t i = 0; i < fl->size() && ret == 0; i++)
+			ret = add(fl->get(i, buf));
+	} else {
+		std::ifstream ifs;
+		ifs.exceptions(std::ofstream::failbit | std::ifstream::badbit);
+		ifs.open(_flist_file);
+		ifs.exceptions(std::ifstream::badbit);
+		std::string s;
+		while (ret == 0 && std::getline(ifs, s))
+			ret = add(s);
+	}
+	if (ret != 0)
+		return ret;
+
+	// don't allow empty flist as it results in spinning loop
+	if (pass == 0)
+		for (size_t i = 0; i < _input.size(); i++) {
+			if (counts[i] > 0) {
+				std::cout << "flist " << _input[i] << " "
+					<< counts[i] << std::endl;
+			} else {
+				std::cout << "empty flist " << _input[i]
+					<< std::endl;
+				return -EINVAL;
+			}
+		}
+
+	for (size_t i = 0; i < _input.size(); i++) {
+		if (chunks[i] && !publish(i, chunks[i]))
+			return 1;
+		std::shared_ptr<PathTable> end; // end of pass
+		if (!publish(i, end))
+			return 1;
+	}
+	xlog("flist stream pass %lu done", pass);
+	return 0;
+}
+
+void FlistStream::produce(void) {
+	auto ret = 0;
+	try {
+		// binary flist is mapped once for all passes
+		std::unique_ptr<MmapFlist> fl;
+		if (is_binary_flist_file(_flist_file))
+			fl = std::make_unique<MmapFlist>(_flist_file);
+		for (unsigned long pass = 0; ret == 0 && !is_all_closed();
+			pass++)
+			ret = produce_pass(pass, fl.get());
+	} catch (const std::exception& e) {
+		add_exception(e);
+		std::cout << e.what() << std::endl;
+		ret = -EIO;
+	}
+	for (auto& q : _queues)
+		q->finish(ret < 0 ? ret : 0);
+}
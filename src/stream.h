@@ -0,0 +1,66 @@
+#ifndef SRC_STREAM_H_
+#define SRC_STREAM_H_
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+
+#include "./flist.h"
+#include "./thread.h"
+
+const size_t FLIST_CHUNK_SIZE = 4096; // paths per chunk
+const size_t FLIST_QUEUE_DEPTH = 4; // chunks per consumer
+
+// bounded single producer single consumer queue of flist chunks,
+// nullptr chunk marks end of a pass
+class ChunkQueue {
+	public:
+	explicit ChunkQueue(size_t);
+	ChunkQueue(const ChunkQueue&) = delete;
+	ChunkQueue& operator=(const ChunkQueue&) = delete;
+
+	bool push(std::shared_ptr<const Flist>);
+	int pop(std::shared_ptr<const Flist>&);
+	void close(void);
+	void finish(int);
+	bool is_closed(void);
+
+	private:
+	Mutex _mutex;
+	Cond _cond;
+	std::deque<std::shared_ptr<const Flist>> _q;
+	size_t _depth;
+	bool _closed; // by consumer
+	bool _finished; // by producer
+	int _error;
+};
+
+// reads flist file in chunks and feeds every consumer of each input
+// directory, repeats from the beginning until all consumers are closed,
+// a full queue blocks the producer, so consumers of all inputs are tied
+// to the slowest one
+class FlistStream {
+	public:
+	FlistStream(const std::string&, const std::vector<std::string>&);
+	FlistStream(const FlistStream&) = delete;
+	FlistStream& operator=(const FlistStream&) = delete;
+
+	ChunkQueue* add_consumer(size_t);
+	int start(void);
+	int join(void);
+	void produce(void);
+
+	private:
+	int produce_pass(unsigned long, const Flist*);
+	bool publish(size_t, std::shared_ptr<PathTable>&);
+	bool is_all_closed(void);
+
+	std::string _flist_file;
+	const std::vector<std::string>& _input;
+	PrefixMatcher _matcher;
+	std::vector<std::unique_ptr<ChunkQueue>> _queues;
+	std::vector<size_t> _queue_input; // input index of each queue
+	Thread _thread;
+};
+#endif // SRC_STREAM_H_
@@ -22,6 +22,57 @@ static inline void global_unlock(void) {
 	pthread_mutex_unlock(&__mutex);
 }
 
+class Mutex {
+	public:
+	Mutex(void) {
+		pthread_mutex_init(&_m, nullptr);
+	}
+	Mutex(const Mutex&) = delete;
+	Mutex& operator=(const Mutex&) = delete;
+	~Mutex(void) {
+		pthread_mutex_destroy(&_m);
+	}
+	void lock(void) {
+		pthread_mutex_lock(&_m);
+	}
+	bool try_lock(void) {
+		return pthread_mutex_trylock(&_m) == 0;
+	}
+	void unlock(void) {
+		pthread_mutex_unlock(&_m);
+	}
+	pthread_mutex_t* get(void) {
+		return &_m;
+	}
+
+	private:
+	pthread_mutex_t _m;
+};
+
+class Cond {
+	public:
+	Cond(void) {
+		pthread_cond_init(&_c, nullptr);
+	}
+	Cond(const Cond&) = delete;
+	Cond& operator=(const Cond&) = delete;
+	~Cond(void) {
+		pthread_cond_destroy(&_c);
+	}
+	void wait(Mutex& m) {
+		pthread_cond_wait(&_c, m.get());
+	}
+	void signal(void) {
+		pthread_cond_signal(&_c);
+	}
+	void broadcast(void) {
+		pthread_cond_broadcast(&_c);
+	}
+
+	private:
+	pthread_cond_t _c;
+};
+
 class Thread {
 	public:
 	Thread(void):
@@ -3,6 +3,7 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 
 #define EXTERN_C_BEGIN
 #define EXTERN_C_END
@@ -28,6 +29,44 @@ static inline void global_unlock(void) {
 #define global_unlock()	do {} while (0)
 #endif
 
+class Mutex {
+	public:
+	void lock(void) {
+		_m.lock();
+	}
+	bool try_lock(void) {
+		return _m.try_lock();
+	}
+	void unlock(void) {
+		_m.unlock();
+	}
+	std::mutex& get(void) {
+		return _m;
+	}
+
+	private:
+	std::mutex _m;
+};
+
+class Cond {
+	public:
+	void wait(Mutex& m) {
+		// caller holds the lock
+		std::unique_lock<std::mutex> l(m.get(), std::adopt_lock);
+		_c.wait(l);
+		l.release();
+	}
+	void signal(void) {
+		_c.notify_one();
+	}
+	void broadcast(void) {
+		_c.notify_all();
+	}
+
+	private:
+	std::condition_variable _c;
+};
+
 class Thread {
 	public:
 	Thread(void):
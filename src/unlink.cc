@@ -0,0 +1,232 @@
+#include <iostream>
+#include <tuple>
+#include <chrono>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
+
+#include <cerrno>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "./log.h"
+#include "./thread.h"
+#include "./unlink.h"
+#include "./util.h"
+
+const size_t UNLINK_BATCH_SIZE = 1024; // entries per dirfd
+
+namespace {
+// entries of a single parent directory in [begin, end),
+// unlinked relative to one dirfd
+struct UnlinkBatch {
+	size_t begin;
+	size_t end;
+	size_t dir_len; // length of parent directory path
+};
+
+// entries of the same depth have no dependency on each other,
+// so each depth is unlinked in parallel after deeper ones
+class Unlinker {
+	public:
+	Unlinker(const std::vector<std::string>&, size_t, unsigned int);
+	Unlinker(const Unlinker&) = delete;
+	Unlinker& operator=(const Unlinker&) = delete;
+
+	int run(std::vector<size_t>&);
+	void unlink(unsigned int);
+
+	private:
+	void unlink_batch(const UnlinkBatch&, unsigned int);
+	void print_progress(void);
+
+	const std::vector<std::string>& _l;
+	size_t _count;
+	unsigned int _num_thread;
+	std::vector<UnlinkBatch> _batches; // of current depth
+	std::atomic<size_t> _next;
+	std::atomic<unsigned long> _done;
+	std::vector<std::vector<size_t>> _failed; // per thread
+	std::chrono::steady_clock::time_point _time_print;
+};
+
+typedef std::tuple<Unlinker*, unsigned int> thread_unlinker_arg;
+
+size_t get_depth(const std::string& f) {
+	return static_cast<size_t>(std::count(f.begin(), f.end(), '/'));
+}
+
+Unlinker::Unlinker(const std::vector<std::string>& l, size_t count,
+	unsigned int num_thread):
+	_l(l),
+	_count(count),
+	_num_thread(num_thread),
+	_batches{},
+	_next(0),
+	_done(0),
+	_failed(num_thread),
+	_time_print(std::chrono::steady_clock::now()) {
+	assert(_num_thread > 0);
+	assert(_count <= _l.size());
+}
+
+void Unlinker::print_progress(void) {
+	auto t = std::chrono::steady_clock::now();
+	if (t - _time_print < std::chrono::seconds(1))
+		return;
+	_time_print = t;
+	std::cout << "Unlinked " << _done << " / " << _count
+		<< " write paths" << std::endl;
+}
+
+void Unlinker::unlink_batch(const UnlinkBatch& b, unsigned int id) {
+	auto& failed = _failed[id];
+	auto d = _l[b.begin].substr(0, b.dir_len);
+	auto dfd = open(d.empty() ? "/" : d.c_str(), O_RDONLY | O_DIRECTORY);
+	if (dfd < 0) {
+		// parent directory is gone with the entries
+		if (errno == ENOENT) {
+			_done += b.end - b.begin;
+			return;
+		}
+		xlog("unlinker %u %s failed %d", id, d.c_str(), -errno);
+		for (auto i = b.begin; i < b.end; i++)
+			failed.push_back(i);
+		return;
+	}
+	for (auto i = b.begin; i < b.end; i++) {
+		// don't resolve symlink (unlink symlink itself, not target)
+		auto name = _l[i].c_str() + b.dir_len + 1;
+		auto ret = unlinkat(dfd, name, 0);
+		// EPERM for directory unless Linux
+		if (ret < 0 && (errno == EISDIR || errno == EPERM))
+			ret = unlinkat(dfd, name, AT_REMOVEDIR);
+		if (ret < 0 && errno != ENOENT) {
+			xlog("unlinker %u %s failed %d", id, _l[i].c_str(),
+				-errno);
+			failed.push_back(i);
+		} else {
+			_done++;
+		}
+	}
+	close(dfd);
+}
+
+void Unlinker::unlink(unsigned int id) {
+	while (true) {
+		auto i = _next.fetch_add(1, std::memory_order_relaxed);
+		if (i >= _batches.size())
+			break;
+		unlink_batch(_batches[i], id);
+		// calling thread reports progress
+		if (id == 0)
+			print_progress();
+	}
+}
+
+EXTERN_C_BEGIN
+void* unlinker_handler(void* arg) {
+	auto [unlinker, id] = *reinterpret_cast<thread_unlinker_arg*>(arg);
+	unlinker->unlink(id);
+	return nullptr;
+}
+EXTERN_C_END
+
+// l is sorted deepest first, then by path
+int Unlinker::run(std::vector<size_t>& failed) {
+	std::vector<Thread> thrv(_num_thread);
+	std::vector<thread_unlinker_arg> argv;
+	for (unsigned int i = 0; i < _num_thread; i++)
+		argv.push_back({this, i});
+
+	size_t i = 0;
+	while (i < _count) {
+		// entries of a parent directory are contiguous in a depth
+		_batches.clear();
+		auto depth = get_depth(_l[i]);
+		while (i < _count && get_depth(_l[i]) == depth) {
+			auto dir_len = _l[i].rfind('/');
+			assert(dir_len != std::string::npos);
+			UnlinkBatch b{i, i + 1, dir_len};
+			while (b.end < _count &&
+				b.end - b.begin < UNLINK_BATCH_SIZE &&
+				_l[b.end].rfind('/') == dir_len &&
+				_l[b.end].compare(0, dir_len, _l[i], 0,
+				dir_len) == 0)
+				b.end++;
+			_batches.push_back(b);
+			i = b.end;
+		}
+		_next = 0;
+
+		// calling thread is #0
+		auto n = std::min(static_cast<size_t>(_num_thread),
+			_batches.size());
+		for (size_t j = 1; j < n; j++) {
+			auto ret = thrv[j].create(unlinker_handler, &argv[j]);
+			if (ret) {
+				xlog("unlinker %zu create failed %d", j, ret);
+				// let created ones finish this depth
+				_next = _batches.size();
+				for (size_t k = 1; k < j; k++)
+					thrv[k].join();
+				return -ret;
+			}
+		}
+		unlink(0);
+		for (size_t j = 1; j < n; j++) {
+			auto ret = thrv[j].join();
+			if (ret) {
+				xlog("unlinker %zu join failed %d", j, ret);
+				return -ret;
+			}
+		}
+	}
+
+	failed.clear();
+	for (const auto& v : _failed)
+		failed.insert(failed.end(), v.begin(), v.end());
+	return 0;
+}
+} // namespace
+
+int unlink_write_paths(std::vector<std::string>& l, long count,
+	unsigned int num_thread, UnlinkStat& us) {
+	auto lsize = static_cast<long>(l.size());
+	auto n = lsize; // unlink all by default
+	if (count > 0) {
+		n = count;
+		if (n > lsize)
+			n = lsize;
+	}
+	std::cout << "Unlink " << n << " write paths" << std::endl;
+	// children before parent directory
+	std::sort(l.begin(), l.end(),
+		[](const std::string& a, const std::string& b) {
+			auto x = get_depth(a);
+			auto y = get_depth(b);
+			return x != y ? x > y : a < b;
+		});
+
+	if (num_thread == 0)
+		num_thread = get_num_cpus();
+	auto t = std::chrono::steady_clock::now();
+	Unlinker unlinker(l, static_cast<size_t>(n), num_thread);
+	std::vector<size_t> failed;
+	auto ret = unlinker.run(failed);
+	if (ret < 0)
+		return ret;
+	std::chrono::duration<double> d = std::chrono::steady_clock::now() - t;
+	us.num_unlinked += static_cast<unsigned long>(n) - failed.size();
+	us.sec += d.count();
+
+	// leave failed ones and ones not to unlink
+	std::vector<std::string> remain;
+	for (auto i : failed)
+		remain.push_back(std::move(l[i]));
+	std::move(l.begin() + n, l.end(), std::back_inserter(remain));
+	l = std::move(remain);
+	return 0;
+}
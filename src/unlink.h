@@ -0,0 +1,13 @@
+#ifndef SRC_UNLINK_H_
+#define SRC_UNLINK_H_
+
+#include <vector>
+#include <string>
+
+#include "./stat.h"
+
+// unlinks write paths deepest first in parallel,
+// paths not unlinked are left in the vector
+int unlink_write_paths(std::vector<std::string>&, long, unsigned int,
+	UnlinkStat&);
+#endif // SRC_UNLINK_H_
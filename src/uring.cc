@@ -0,0 +1,436 @@
+#include <atomic>
+#include <system_error>
+
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "./dir.h"
+#include "./global.h"
+#include "./uring.h"
+#include "./worker.h"
+
+namespace {
+unsigned int load_acquire(unsigned int* p) {
+	return std::atomic_ref<unsigned int>(*p).load(
+		std::memory_order_acquire);
+}
+
+void store_release(unsigned int* p, unsigned int v) {
+	std::atomic_ref<unsigned int>(*p).store(v, std::memory_order_release);
+}
+
+void* map_ring(int fd, size_t siz, off_t off) {
+	auto p = mmap(nullptr, siz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, off);
+	if (p == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(),
+			"io_uring mmap");
+	return p;
+}
+} // namespace
+
+Uring::Uring(unsigned int entries):
+	_fd(-1),
+	_sq_ptr(nullptr),
+	_sq_size(0),
+	_cq_ptr(nullptr),
+	_cq_size(0),
+	_sqes(nullptr),
+	_sqes_size(0),
+	_sq_head(nullptr),
+	_sq_tail(nullptr),
+	_sq_mask(nullptr),
+	_sq_array(nullptr),
+	_cq_head(nullptr),
+	_cq_tail(nullptr),
+	_cq_mask(nullptr),
+	_cqes(nullptr),
+	_sq_entries(0),
+	_num_pending(0) {
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+	if (_fd < 0)
+		throw std::system_error(errno, std::generic_category(),
+			"io_uring_setup");
+
+	_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	try {
+		if (p.features & IORING_FEAT_SINGLE_MMAP) {
+			if (_cq_size > _sq_size)
+				_sq_size = _cq_size;
+			_sq_ptr = map_ring(_fd, _sq_size, IORING_OFF_SQ_RING);
+			_cq_ptr = _sq_ptr;
+			_cq_size = 0; // shared with sq
+		} else {
+			_sq_ptr = map_ring(_fd, _sq_size, IORING_OFF_SQ_RING);
+			_cq_ptr = map_ring(_fd, _cq_size, IORING_OFF_CQ_RING);
+		}
+		_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+		_sqes = static_cast<io_uring_sqe*>(map_ring(_fd, _sqes_size,
+			IORING_OFF_SQES));
+	} catch (...) {
+		cleanup();
+		throw;
+	}
+
+	auto sq = static_cast<char*>(_sq_ptr);
+	_sq_head = reinterpret_cast<unsigned int*>(sq + p.sq_off.head);
+	_sq_tail = reinterpret_cast<unsigned int*>(sq + p.sq_off.tail);
+	_sq_mask = reinterpret_cast<unsigned int*>(sq + p.sq_off.ring_mask);
+	_sq_array = reinterpret_cast<unsigned int*>(sq + p.sq_off.array);
+	auto cq = static_cast<char*>(_cq_ptr);
+	_cq_head = reinterpret_cast<unsigned int*>(cq + p.cq_off.head);
+	_cq_tail = reinterpret_cast<unsigned int*>(cq + p.cq_off.tail);
+	_cq_mask = reinterpret_cast<unsigned int*>(cq + p.cq_off.ring_mask);
+	_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+	_sq_entries = p.sq_entries;
+}
+
+Uring::~Uring(void) {
+	cleanup();
+}
+
+void Uring::cleanup(void) {
+	if (_sqes)
+		munmap(_sqes, _sqes_size);
+	if (_cq_ptr && _cq_size)
+		munmap(_cq_ptr, _cq_size);
+	if (_sq_ptr)
+		munmap(_sq_ptr, _sq_size);
+	if (_fd != -1)
+		close(_fd);
+	_sqes = nullptr;
+	_cq_ptr = nullptr;
+	_sq_ptr = nullptr;
+	_fd = -1;
+}
+
+io_uring_sqe* Uring::get_sqe(void) {
+	auto tail = *_sq_tail + _num_pending;
+	if (tail - load_acquire(_sq_head) >= _sq_entries)
+		return nullptr;
+	auto idx = tail & *_sq_mask;
+	_sq_array[idx] = idx;
+	_num_pending++;
+	auto sqe = &_sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+int Uring::submit(unsigned int wait_nr) {
+	auto tail = *_sq_tail + _num_pending;
+	store_release(_sq_tail, tail);
+	_num_pending = 0;
+
+	while (1) {
+		auto n = tail - load_acquire(_sq_head);
+		auto flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+		if (n == 0 && wait_nr == 0)
+			return 0;
+		auto ret = syscall(__NR_io_uring_enter, _fd, n, wait_nr, flags,
+			nullptr, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		return static_cast<int>(ret);
+	}
+}
+
+io_uring_cqe* Uring::peek_cqe(void) {
+	auto head = *_cq_head;
+	if (head == load_acquire(_cq_tail))
+		return nullptr;
+	return &_cqes[head & *_cq_mask];
+}
+
+void Uring::advance_cqe(void) {
+	store_release(_cq_head, *_cq_head + 1);
+}
+
+UringEngine::UringEngine(unsigned int depth, unsigned long bufsiz,
+	int oflags):
+	_ring(depth),
+	_slots{},
+	_free{},
+	_num_inflight(0),
+	_oflags(oflags),
+	_error(0),
+	_path{} {
+	assert(depth > 0);
+	auto c = (oflags & O_ACCMODE) == O_RDONLY ||
+		opt::write_data != WriteData::Pattern ? 0 : 0x41;
+	_slots.reserve(depth);
+	for (unsigned int i = 0; i < depth; i++) {
+		_slots.push_back({State::Free, {}, -1, 0, 0, nullptr,
+			Buffer(bufsiz, c, get_page_size(), opt::buffer_type),
+			{}, {}});
+		_free.push_back(depth - 1 - i);
+	}
+}
+
+UringEngine::~UringEngine(void) {
+	// wait for in-flight operations without accounting them
+	while (_num_inflight > 0) {
+		if (_ring.submit(1) < 0)
+			break;
+		io_uring_cqe* cqe;
+		while ((cqe = _ring.peek_cqe()) != nullptr) {
+			auto& slot = _slots[cqe->user_data];
+			if (slot.state == State::Openat && cqe->res >= 0)
+				close(cqe->res);
+			else if (slot.state == State::Read ||
+				slot.state == State::Write ||
+				slot.state == State::Fsync)
+				close(slot.fd);
+			_ring.advance_cqe();
+			release_slot(slot);
+		}
+	}
+}
+
+int UringEngine::stat_entry(const std::string& f, XThread& thr) {
+	auto& slot = get_slot(thr);
+	slot.path = f;
+	prep_sqe(slot, State::Statx);
+	return take_error();
+}
+
+int UringEngine::read_file(const std::string& f, long resid, XThread& thr) {
+	auto& slot = get_slot(thr);
+	slot.path = f;
+	slot.resid = resid;
+	slot.dir = nullptr;
+	prep_sqe(slot, State::Openat);
+	return take_error();
+}
+
+int UringEngine::write_file(const std::string& f, long resid, XThread& thr,
+	const Dir& dir) {
+	assert(resid > 0);
+	auto& slot = get_slot(thr);
+	slot.path = f;
+	slot.resid = resid;
+	slot.dir = &dir;
+	prep_sqe(slot, State::Openat);
+	return take_error();
+}
+
+int UringEngine::flush(XThread& thr) {
+	while (_num_inflight > 0) {
+		auto ret = reap(1, thr);
+		if (ret < 0)
+			return ret;
+	}
+	return take_error();
+}
+
+UringEngine::Slot& UringEngine::get_slot(XThread& thr) {
+	// reap completions in batch until a slot is available
+	while (_free.empty()) {
+		auto ret = reap(1, thr);
+		if (ret < 0)
+			throw std::system_error(-ret, std::generic_category(),
+				"io_uring_enter");
+	}
+	auto& slot = _slots[_free.back()];
+	_free.pop_back();
+	_num_inflight++;
+	assert(slot.state == State::Free);
+	return slot;
+}
+
+void UringEngine::release_slot(Slot& slot) {
+	assert(slot.state != State::Free);
+	slot.state = State::Free;
+	slot.fd = -1;
+	_free.push_back(static_cast<unsigned int>(&slot - _slots.data()));
+	_num_inflight--;
+}
+
+int UringEngine::reap(unsigned int wait_nr, XThread& thr) {
+	auto ret = _ring.submit(wait_nr);
+	if (ret < 0)
+		return ret;
+	io_uring_cqe* cqe;
+	while ((cqe = _ring.peek_cqe()) != nullptr) {
+		auto& slot = _slots[cqe->user_data];
+		auto res = cqe->res;
+		_ring.advance_cqe();
+		complete(slot, res, thr);
+	}
+	return 0;
+}
+
+void UringEngine::complete(Slot& slot, int res, XThread& thr) {
+	switch (slot.state) {
+	case State::Statx: {
+		thr.get_mut_stat().inc_num_stat();
+		// removed entry is skipped as in lstat(2) path
+		if (res < 0) {
+			if (res != -ENOENT)
+				set_error(res);
+			release_slot(slot);
+			break;
+		}
+		auto t = get_mode_file_type(slot.stx.stx_mode);
+		auto size = static_cast<off_t>(slot.stx.stx_size);
+		// continue with the slot released, next state takes a new one
+		_path = slot.path;
+		release_slot(slot);
+		set_error(read_entry_type(_path, t, size, thr));
+		break;
+	}
+	case State::Openat:
+		if (res < 0) {
+			set_error(res);
+			release_slot(slot);
+			break;
+		}
+		slot.fd = res;
+		slot.off = 0;
+		if (slot.dir == nullptr)
+			prep_sqe(slot, State::Read);
+		else
+			prep_sqe(slot, State::Write);
+		break;
+	case State::Read: {
+		if (res < 0) {
+			set_error(res);
+			prep_sqe(slot, State::Close);
+			break;
+		}
+		thr.get_mut_stat().inc_num_read();
+		thr.get_mut_stat().add_num_read_bytes(res);
+		if (res == 0) {
+			prep_sqe(slot, State::Close);
+			break;
+		}
+		slot.off += res;
+		// end if positive residual becomes <= 0
+		if (slot.resid > 0) {
+			slot.resid -= res;
+			if (slot.resid <= 0) {
+				prep_sqe(slot, State::Close);
+				break;
+			}
+		}
+		prep_sqe(slot, State::Read);
+		break;
+	}
+	case State::Write:
+		if (res < 0) {
+			set_error(res);
+			prep_sqe(slot, State::Close);
+			break;
+		}
+		thr.get_mut_stat().inc_num_write();
+		thr.get_mut_stat().add_num_write_bytes(res);
+		slot.off += res;
+		slot.resid -= res;
+		if (slot.resid > 0)
+			prep_sqe(slot, State::Write);
+		else if (opt::fsync_write_paths)
+			prep_sqe(slot, State::Fsync);
+		else
+			prep_sqe(slot, State::Close);
+		break;
+	case State::Fsync:
+		// from submission, includes time queued behind other slots
+		thr.get_mut_stat().add_sync_latency(SyncClass::File,
+			std::chrono::steady_clock::now() - slot.time_sync);
+		if (res < 0)
+			set_error(res);
+		prep_sqe(slot, State::Close);
+		break;
+	case State::Close:
+		if (res < 0)
+			set_error(res);
+		release_slot(slot);
+		break;
+	case State::Free:
+		assert(false);
+		break;
+	}
+}
+
+void UringEngine::prep_sqe(Slot& slot, State state) {
+	// one sqe per slot, so the ring never runs out of sqes
+	auto sqe = _ring.get_sqe();
+	assert(sqe);
+	sqe->user_data = static_cast<__u64>(&slot - _slots.data());
+	slot.state = state;
+
+	auto bufsiz = slot.buf.size();
+	auto n = bufsiz;
+	switch (state) {
+	case State::Statx:
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<__u64>(slot.path.c_str());
+		sqe->len = STATX_TYPE | STATX_SIZE;
+		sqe->off = reinterpret_cast<__u64>(&slot.stx);
+		sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+		break;
+	case State::Openat:
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<__u64>(slot.path.c_str());
+		sqe->open_flags = _oflags;
+		break;
+	case State::Read:
+		// cut read size if > positive residual
+		if (slot.resid > 0 && n > static_cast<size_t>(slot.resid))
+			n = slot.resid;
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = slot.fd;
+		sqe->addr = reinterpret_cast<__u64>(slot.buf.data());
+		sqe->len = static_cast<__u32>(n);
+		sqe->off = slot.off;
+		break;
+	case State::Write:
+		// cut write size if > residual
+		if (n > static_cast<size_t>(slot.resid))
+			n = slot.resid;
+		fill_write_buffer(slot.buf.data(), n, slot.off);
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = slot.fd;
+		sqe->addr = reinterpret_cast<__u64>(slot.buf.data());
+		sqe->len = static_cast<__u32>(n);
+		sqe->off = slot.off;
+		break;
+	case State::Fsync:
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = slot.fd;
+		slot.time_sync = std::chrono::steady_clock::now();
+		break;
+	case State::Close:
+		sqe->opcode = IORING_OP_CLOSE;
+		sqe->fd = slot.fd;
+		break;
+	case State::Free:
+		assert(false);
+		break;
+	}
+}
+
+void UringEngine::set_error(int error) {
+	// keep the first error, returned by the next call
+	if (error < 0 && _error == 0)
+		_error = error;
+}
+
+int UringEngine::take_error(void) {
+	auto error = _error;
+	_error = 0;
+	return error;
+}
@@ -0,0 +1,103 @@
+#ifndef SRC_URING_H_
+#define SRC_URING_H_
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <linux/io_uring.h>
+#include <sys/stat.h>
+
+#include "./util.h"
+
+// minimal io_uring(7) ring using raw syscalls (no liburing dependency)
+class Uring {
+	public:
+	explicit Uring(unsigned int);
+	Uring(const Uring&) = delete;
+	Uring& operator=(const Uring&) = delete;
+	~Uring(void);
+
+	io_uring_sqe* get_sqe(void);
+	int submit(unsigned int);
+	io_uring_cqe* peek_cqe(void);
+	void advance_cqe(void);
+
+	private:
+	void cleanup(void);
+
+	int _fd;
+	void* _sq_ptr;
+	size_t _sq_size;
+	void* _cq_ptr;
+	size_t _cq_size;
+	io_uring_sqe* _sqes;
+	size_t _sqes_size;
+	unsigned int* _sq_head;
+	unsigned int* _sq_tail;
+	unsigned int* _sq_mask;
+	unsigned int* _sq_array;
+	unsigned int* _cq_head;
+	unsigned int* _cq_tail;
+	unsigned int* _cq_mask;
+	io_uring_cqe* _cqes;
+	unsigned int _sq_entries;
+	unsigned int _num_pending;
+};
+
+class XThread;
+class Dir;
+
+// keeps up to iodepth files in flight per thread,
+// each file goes through statx -> openat -> read/write... -> fsync -> close
+class UringEngine {
+	public:
+	UringEngine(unsigned int, unsigned long, int);
+	UringEngine(const UringEngine&) = delete;
+	UringEngine& operator=(const UringEngine&) = delete;
+	~UringEngine(void);
+
+	int stat_entry(const std::string&, XThread&);
+	int read_file(const std::string&, long, XThread&);
+	int write_file(const std::string&, long, XThread&, const Dir&);
+	int flush(XThread&);
+
+	private:
+	enum class State {
+		Free,
+		Statx,
+		Openat,
+		Read,
+		Write,
+		Fsync,
+		Close,
+	};
+	struct Slot {
+		State state;
+		std::string path;
+		int fd;
+		off_t off;
+		long resid;
+		const Dir* dir;
+		Buffer buf;
+		struct statx stx;
+		std::chrono::steady_clock::time_point time_sync; // of fsync
+	};
+
+	Slot& get_slot(XThread&);
+	void release_slot(Slot&);
+	int reap(unsigned int, XThread&);
+	void complete(Slot&, int, XThread&);
+	void prep_sqe(Slot&, State);
+	void set_error(int);
+	int take_error(void);
+
+	Uring _ring;
+	std::vector<Slot> _slots;
+	std::vector<unsigned int> _free;
+	unsigned int _num_inflight;
+	int _oflags;
+	int _error;
+	std::string _path;
+};
+#endif // SRC_URING_H_
@@ -1,8 +1,21 @@
 #include <sstream>
 #include <filesystem>
 #include <exception>
+#include <system_error>
+#include <stdexcept>
 
+#include <new>
+
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <climits>
 #include <ctime>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "./util.h"
 
@@ -85,6 +98,19 @@ FileType get_mode_type(const std::filesystem::file_type& t) {
 }
 } // namespace
 
+FileType get_mode_file_type(mode_t mode) {
+	if (S_ISDIR(mode))
+		return FileType::Dir;
+	else if (S_ISREG(mode))
+		return FileType::Reg;
+	else if (S_ISBLK(mode) || S_ISCHR(mode))
+		return FileType::Device;
+	else if (S_ISLNK(mode))
+		return FileType::Symlink;
+	else
+		return FileType::Unsupported;
+}
+
 FileType get_raw_file_type(const std::string& f) {
 	try {
 		return get_mode_type(std::filesystem::symlink_status(f).type());
@@ -101,6 +127,19 @@ FileType get_file_type(const std::string& f) {
 	}
 }
 
+// single lstat(2) / stat(2), st is valid unless Unsupported
+FileType get_raw_file_type(const std::string& f, struct stat& st) {
+	if (lstat(f.c_str(), &st) < 0)
+		return FileType::Unsupported;
+	return get_mode_file_type(st.st_mode);
+}
+
+FileType get_file_type(const std::string& f, struct stat& st) {
+	if (stat(f.c_str(), &st) < 0)
+		return FileType::Unsupported;
+	return get_mode_file_type(st.st_mode);
+}
+
 // std::filesystem::exists can't be used as it resolves symlink
 bool path_exists(const std::string& f) {
 	try {
@@ -154,6 +193,49 @@ remove_dup_string(const std::vector<std::string>& input) {
 	return l;
 }
 
+// input directories for messages
+std::string join_input(const std::vector<std::string>& input) {
+	std::ostringstream ss;
+	for (size_t i = 0; i < input.size(); i++) {
+		ss << input[i];
+		if (i != input.size() - 1)
+			ss << ", ";
+	}
+	return ss.str();
+}
+
+// size with optional K, M, G or T suffix (powers of 1024)
+long parse_size(const std::string& s) {
+	size_t pos;
+	auto x = std::stol(s, &pos);
+	if (x < 0)
+		throw std::invalid_argument(s);
+	long unit = 1;
+	if (pos < s.size()) {
+		if (pos + 1 != s.size())
+			throw std::invalid_argument(s);
+		switch (std::toupper(s[pos])) {
+		case 'T':
+			unit <<= 10;
+			[[fallthrough]];
+		case 'G':
+			unit <<= 10;
+			[[fallthrough]];
+		case 'M':
+			unit <<= 10;
+			[[fallthrough]];
+		case 'K':
+			unit <<= 10;
+			break;
+		default:
+			throw std::invalid_argument(s);
+		}
+	}
+	if (x > LONG_MAX / unit)
+		throw std::out_of_range(s);
+	return x * unit;
+}
+
 std::string get_time_string(void) {
 	time_t t;
 	time(&t);
@@ -162,16 +244,77 @@ std::string get_time_string(void) {
 	return std::string(buf);
 }
 
-std::mt19937& get_random_engine(void) {
-	static std::random_device seed_gen;
-	static std::mt19937 engine;
-	static auto init = false;
+size_t get_page_size(void) {
+	static const auto siz = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	return siz;
+}
+
+unsigned int get_num_cpus(void) {
+	auto n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? static_cast<unsigned int>(n) : 1;
+}
+
+namespace {
+uint64_t splitmix64(uint64_t& x) {
+	auto z = (x += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+uint64_t get_random_seed(void) {
+	std::random_device seed_gen;
+	return (static_cast<uint64_t>(seed_gen()) << 32) | seed_gen();
+}
+
+// each thread has its own engine, no sharing between threads
+thread_local Xoshiro256pp _engine(get_random_seed());
+} // namespace
+
+// state is expanded from seed by splitmix64 as recommended by the authors
+Xoshiro256pp::Xoshiro256pp(uint64_t seed) {
+	for (auto& x : _s)
+		x = splitmix64(seed);
+}
+
+// seeds engine of the calling thread, random if seed < 0,
+// otherwise engines of different ids are independent but reproducible
+void init_random_engine(long seed, unsigned long id) {
+	if (seed < 0) {
+		_engine = Xoshiro256pp(get_random_seed());
+	} else {
+		auto x = static_cast<uint64_t>(seed);
+		x = splitmix64(x) ^ id;
+		_engine = Xoshiro256pp(splitmix64(x));
+	}
+}
+
+Xoshiro256pp& get_random_engine(void) {
+	return _engine;
+}
 
-	if (!init) {
-		engine = std::mt19937(seed_gen());
-		init = true;
+RandomFiller::RandomFiller(Xoshiro256pp& e) {
+	for (auto i = 0; i < LANES; i++) {
+		_s0[i] = e();
+		_s1[i] = e();
+		_s2[i] = e();
+		_s3[i] = e();
+	}
+}
+
+void RandomFiller::fill(void* buf, size_t siz) {
+	auto p = static_cast<unsigned char*>(buf);
+	uint64_t out[LANES];
+	while (siz >= sizeof(out)) {
+		next(out);
+		memcpy(p, out, sizeof(out));
+		p += sizeof(out);
+		siz -= sizeof(out);
+	}
+	if (siz > 0) {
+		next(out);
+		memcpy(p, out, siz);
 	}
-	return engine;
 }
 
 Timer::Timer(long duration, long frequency):
@@ -197,6 +340,84 @@ void Timer::reset(void) {
 	_time_begin = std::chrono::steady_clock::now();
 }
 
+namespace {
+// default huge page size on x86_64 and arm64 with 4K pages
+const size_t HUGE_PAGE_SIZE = 2lu << 20;
+
+void* alloc_huge_page_buffer(size_t siz, BufferType t) {
+	auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if (t == BufferType::Hugetlb) {
+#ifdef MAP_HUGETLB
+		flags |= MAP_HUGETLB;
+#else
+		throw std::system_error(EOPNOTSUPP, std::generic_category(),
+			"MAP_HUGETLB");
+#endif
+	}
+	// hugetlb mappings are aligned by kernel,
+	// anonymous ones are only page aligned
+	auto map_size = siz;
+	if (t == BufferType::Thp)
+		map_size += HUGE_PAGE_SIZE;
+	auto p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (p == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), "mmap");
+	if (t != BufferType::Thp)
+		return p;
+
+	// trim unaligned head and tail
+	auto head = reinterpret_cast<uintptr_t>(p);
+	auto addr = (head + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	if (addr > head)
+		munmap(p, addr - head);
+	auto tail = head + map_size - (addr + siz);
+	if (tail > 0)
+		munmap(reinterpret_cast<void*>(addr + siz), tail);
+	p = reinterpret_cast<void*>(addr);
+#ifdef MADV_HUGEPAGE
+	madvise(p, siz, MADV_HUGEPAGE); // only a hint
+#endif
+	return p;
+}
+} // namespace
+
+Buffer::Buffer(size_t siz, int c, size_t align, BufferType t):
+	_data(nullptr),
+	_size(siz),
+	_map_size(0) {
+	if (siz == 0)
+		return;
+	void* p;
+	if (t != BufferType::Heap) {
+		_map_size = (siz + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		p = alloc_huge_page_buffer(_map_size, t);
+	} else if (align == 0) {
+		p = malloc(siz);
+	} else if (posix_memalign(&p, align, siz)) {
+		p = nullptr;
+	}
+	if (p == nullptr)
+		throw std::bad_alloc();
+	_data = static_cast<char*>(p);
+	memset(_data, c, siz);
+}
+
+Buffer::Buffer(Buffer&& b):
+	_data(b._data),
+	_size(b._size),
+	_map_size(b._map_size) {
+	b._data = nullptr;
+	b._size = 0;
+	b._map_size = 0;
+}
+
+Buffer::~Buffer(void) {
+	if (_map_size)
+		munmap(_data, _map_size);
+	else
+		free(_data);
+}
+
 #ifdef CONFIG_CPPUNIT
 #include <tuple>
 #include <thread>
@@ -305,6 +526,23 @@ void UtilTest::test_get_path_separator(void) {
 	CPPUNIT_ASSERT_EQUAL(get_path_separator(), '/');
 }
 
+void UtilTest::test_get_mode_file_type(void) {
+	const std::vector<std::tuple<mode_t, FileType>> mode_list{
+		{S_IFDIR | 0755, FileType::Dir},
+		{S_IFREG | 0644, FileType::Reg},
+		{S_IFBLK | 0660, FileType::Device},
+		{S_IFCHR | 0660, FileType::Device},
+		{S_IFLNK | 0777, FileType::Symlink},
+		{S_IFIFO | 0644, FileType::Unsupported},
+		{S_IFSOCK | 0755, FileType::Unsupported},
+	};
+	for (const auto& x : mode_list) {
+		const auto [input, output] = x;
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(std::to_string(input),
+			get_mode_file_type(input), output);
+	}
+}
+
 void UtilTest::test_get_raw_file_type(void) {
 	const std::vector<std::string> dir_list{
 		".",
@@ -345,6 +583,36 @@ void UtilTest::test_get_file_type(void) {
 			FileType::Unsupported);
 }
 
+void UtilTest::test_get_file_stat(void) {
+	const std::vector<std::string> dir_list{
+		".",
+		"..",
+		"/",
+		"/dev",
+	};
+	for (const auto& f : dir_list) {
+		struct stat st;
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(f, get_raw_file_type(f, st),
+			FileType::Dir);
+		CPPUNIT_ASSERT_MESSAGE(f, S_ISDIR(st.st_mode));
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(f, get_file_type(f, st),
+			FileType::Dir);
+		CPPUNIT_ASSERT_MESSAGE(f, S_ISDIR(st.st_mode));
+	}
+
+	const std::vector<std::string> invalid_list{
+		"",
+		"516e7cb4-6ecf-11d6-8ff8-00022d09712b",
+	};
+	for (const auto& f : invalid_list) {
+		struct stat st;
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(f, get_raw_file_type(f, st),
+			FileType::Unsupported);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(f, get_file_type(f, st),
+			FileType::Unsupported);
+	}
+}
+
 void UtilTest::test_path_exists(void) {
 	const std::vector<std::string> dir_list{
 		".",
@@ -500,6 +768,37 @@ void UtilTest::test_remove_dup_string(void) {
 	}
 }
 
+void UtilTest::test_join_input(void) {
+	CPPUNIT_ASSERT_EQUAL(join_input({}), std::string(""));
+	CPPUNIT_ASSERT_EQUAL(join_input({"/a"}), std::string("/a"));
+	CPPUNIT_ASSERT_EQUAL(join_input({"/a", "/b/c", "/d"}),
+		std::string("/a, /b/c, /d"));
+}
+
+void UtilTest::test_parse_size(void) {
+	const std::vector<std::tuple<std::string, long>> size_list{
+		{"0", 0},
+		{"4096", 4096},
+		{"1k", 1024},
+		{"64K", 64 << 10},
+		{"3M", 3 << 20},
+		{"2G", 2l << 30},
+		{"1T", 1l << 40},
+	};
+	for (const auto& [s, x] : size_list)
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(s, parse_size(s), x);
+
+	for (const auto& s : {"", "K", "-1", "1KB", "1X", "1.5M"}) {
+		auto thrown = false;
+		try {
+			parse_size(s);
+		} catch (const std::exception& e) {
+			thrown = true;
+		}
+		CPPUNIT_ASSERT_MESSAGE(s, thrown);
+	}
+}
+
 void UtilTest::test_get_random(void) {
 	for (auto i = 1; i < 10000; i++) {
 		auto x = get_random(0, i);
@@ -511,6 +810,61 @@ void UtilTest::test_get_random(void) {
 	}
 }
 
+void UtilTest::test_random_engine(void) {
+	// reference output of xoshiro256plusplus.c
+	Xoshiro256pp e(1, 2, 3, 4);
+	CPPUNIT_ASSERT_EQUAL(e(), static_cast<uint64_t>(41943041));
+	CPPUNIT_ASSERT_EQUAL(e(), static_cast<uint64_t>(58720359));
+	CPPUNIT_ASSERT_EQUAL(e(), static_cast<uint64_t>(3588806011781223));
+
+	// same seed and id result in same sequence
+	std::vector<uint64_t> v;
+	init_random_engine(1234, 1);
+	for (auto i = 0; i < 10; i++)
+		v.push_back(get_random_engine()());
+	init_random_engine(1234, 1);
+	for (auto i = 0; i < 10; i++)
+		CPPUNIT_ASSERT_EQUAL(get_random_engine()(), v[i]);
+	init_random_engine(1234, 2);
+	CPPUNIT_ASSERT(get_random_engine()() != v[0]);
+	init_random_engine(-1, 0);
+
+	// each thread has its own engine
+	auto p = &get_random_engine();
+	Xoshiro256pp* q = nullptr;
+	std::thread t([&]() {
+		q = &get_random_engine();
+	});
+	t.join();
+	CPPUNIT_ASSERT(p != q);
+}
+
+void UtilTest::test_random_filler(void) {
+	// lane 0 is xoshiro256++ seeded with first 4 outputs of engine
+	Xoshiro256pp e(1), e2(1);
+	RandomFiller r(e);
+	uint64_t s[4];
+	for (auto& v : s)
+		v = e2();
+	Xoshiro256pp x(s[0], s[1], s[2], s[3]);
+	uint64_t buf[64];
+	r.fill(buf, sizeof(buf));
+	for (auto i = 0; i < 64; i += 4)
+		CPPUNIT_ASSERT_EQUAL(buf[i], x());
+
+	// partial fill doesn't overrun
+	unsigned char b[40];
+	memset(b, 0, sizeof(b));
+	r.fill(b, 37);
+	for (auto i = 37; i < 40; i++)
+		CPPUNIT_ASSERT_EQUAL(static_cast<int>(b[i]), 0);
+	auto nonzero = 0;
+	for (auto i = 0; i < 37; i++)
+		if (b[i])
+			nonzero++;
+	CPPUNIT_ASSERT(nonzero > 0);
+}
+
 void UtilTest::test_timer1(void) {
 	auto timer = Timer(0, 0); // unused
 	CPPUNIT_ASSERT(!timer.elapsed());
@@ -551,5 +905,44 @@ void UtilTest::test_timer2(void) {
 	CPPUNIT_ASSERT(!timer.elapsed());
 }
 
+void UtilTest::test_get_page_size(void) {
+	auto siz = get_page_size();
+	CPPUNIT_ASSERT(siz >= 512);
+	CPPUNIT_ASSERT_EQUAL(siz & (siz - 1), 0lu);
+}
+
+void UtilTest::test_buffer(void) {
+	const std::vector<size_t> size_list{0, 1, 511, 4096, 65536, 131072};
+	for (const auto& siz : size_list) {
+		auto b = Buffer(siz, 0x41, get_page_size());
+		CPPUNIT_ASSERT_EQUAL(b.size(), siz);
+		if (siz == 0) {
+			CPPUNIT_ASSERT(b.data() == nullptr);
+			continue;
+		}
+		auto p = reinterpret_cast<uintptr_t>(b.data());
+		CPPUNIT_ASSERT_EQUAL(p % get_page_size(), 0lu);
+		for (size_t i = 0; i < siz; i++)
+			CPPUNIT_ASSERT_EQUAL(b.data()[i], 'A');
+
+		auto bb = std::move(b);
+		CPPUNIT_ASSERT_EQUAL(bb.size(), siz);
+		CPPUNIT_ASSERT(b.data() == nullptr);
+		CPPUNIT_ASSERT_EQUAL(b.size(), 0lu);
+	}
+}
+
+void UtilTest::test_buffer_thp(void) {
+	const std::vector<size_t> size_list{1, 4096, 1lu << 21, 3lu << 20};
+	for (const auto& siz : size_list) {
+		auto b = Buffer(siz, 0x41, get_page_size(), BufferType::Thp);
+		CPPUNIT_ASSERT_EQUAL(b.size(), siz);
+		auto p = reinterpret_cast<uintptr_t>(b.data());
+		CPPUNIT_ASSERT_EQUAL(p % (2lu << 20), 0lu);
+		CPPUNIT_ASSERT_EQUAL(b.data()[0], 'A');
+		CPPUNIT_ASSERT_EQUAL(b.data()[siz - 1], 'A');
+	}
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(UtilTest);
 #endif
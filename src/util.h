@@ -6,8 +6,12 @@
 #include <chrono>
 #include <random>
 
+#include <cstdint>
 #include <cassert>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 enum class FileType {
 	Dir,
 	Reg,
@@ -16,6 +20,74 @@ enum class FileType {
 	Unsupported,
 };
 
+// xoshiro256++, small and fast enough to keep one per thread
+// https://prng.di.unimi.it/xoshiro256plusplus.c
+class Xoshiro256pp {
+	public:
+	typedef uint64_t result_type;
+
+	explicit Xoshiro256pp(uint64_t);
+	Xoshiro256pp(uint64_t s0, uint64_t s1, uint64_t s2, uint64_t s3):
+		_s{s0, s1, s2, s3} {
+	}
+	static constexpr result_type min(void) {
+		return 0;
+	}
+	static constexpr result_type max(void) {
+		return UINT64_MAX;
+	}
+	result_type operator()(void) {
+		auto ret = rotl(_s[0] + _s[3], 23) + _s[0];
+		auto t = _s[1] << 17;
+		_s[2] ^= _s[0];
+		_s[3] ^= _s[1];
+		_s[1] ^= _s[2];
+		_s[0] ^= _s[3];
+		_s[2] ^= t;
+		_s[3] = rotl(_s[3], 45);
+		return ret;
+	}
+
+	private:
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+
+	uint64_t _s[4];
+};
+
+// fills memory with 4 interleaved xoshiro256++ streams seeded from
+// an engine, independent lanes let the compiler vectorize the loop
+class RandomFiller {
+	public:
+	explicit RandomFiller(Xoshiro256pp&);
+	void fill(void*, size_t);
+
+	private:
+	static const int LANES = 4;
+
+	void next(uint64_t* out) {
+		for (auto i = 0; i < LANES; i++) {
+			out[i] = rotl(_s0[i] + _s3[i], 23) + _s0[i];
+			auto t = _s1[i] << 17;
+			_s2[i] ^= _s0[i];
+			_s3[i] ^= _s1[i];
+			_s1[i] ^= _s2[i];
+			_s0[i] ^= _s3[i];
+			_s2[i] ^= t;
+			_s3[i] = rotl(_s3[i], 45);
+		}
+	}
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+
+	uint64_t _s0[LANES];
+	uint64_t _s1[LANES];
+	uint64_t _s2[LANES];
+	uint64_t _s3[LANES];
+};
+
 class Timer {
 	public:
 	Timer(long, long);
@@ -29,6 +101,38 @@ class Timer {
 	long _counter;
 };
 
+enum class BufferType {
+	Heap,
+	Thp, // transparent huge pages
+	Hugetlb, // MAP_HUGETLB
+};
+
+// page aligned unless alignment is 0, usable for O_DIRECT,
+// huge page buffers are always aligned to huge page size
+class Buffer {
+	public:
+	Buffer(size_t, int, size_t, BufferType=BufferType::Heap);
+	Buffer(Buffer&&);
+	Buffer(const Buffer&) = delete;
+	Buffer& operator=(const Buffer&) = delete;
+	~Buffer(void);
+
+	char* data(void) {
+		return _data;
+	}
+	const char* data(void) const {
+		return _data;
+	}
+	size_t size(void) const {
+		return _size;
+	}
+
+	private:
+	char* _data;
+	size_t _size;
+	size_t _map_size; // non 0 if mmap'd
+};
+
 std::string get_abspath(const std::string&, bool=false);
 std::string get_dirpath(const std::string&, bool=false);
 std::string get_basename(const std::string&, bool=false);
@@ -37,14 +141,22 @@ std::string join_path(const std::string&, const std::string&, bool=false);
 bool is_linux(void);
 bool is_windows(void);
 char get_path_separator(void);
+FileType get_mode_file_type(mode_t);
 FileType get_raw_file_type(const std::string&);
+FileType get_raw_file_type(const std::string&, struct stat&);
 FileType get_file_type(const std::string&);
+FileType get_file_type(const std::string&, struct stat&);
 bool path_exists(const std::string&);
 bool is_dot_path(const std::string&);
 bool is_dir_writable(const std::string&);
 std::vector<std::string> remove_dup_string(const std::vector<std::string>&);
+std::string join_input(const std::vector<std::string>&);
+long parse_size(const std::string&);
 std::string get_time_string(void);
-std::mt19937& get_random_engine(void);
+size_t get_page_size(void);
+unsigned int get_num_cpus(void);
+void init_random_engine(long, unsigned long);
+Xoshiro256pp& get_random_engine(void);
 
 template <class T> T get_random(T beg, T end) {
 	assert(beg < end);
@@ -69,15 +181,24 @@ class UtilTest: public CPPUNIT_NS::TestFixture {
 	CPPUNIT_TEST(test_is_abspath);
 	CPPUNIT_TEST(test_is_windows);
 	CPPUNIT_TEST(test_get_path_separator);
+	CPPUNIT_TEST(test_get_mode_file_type);
 	CPPUNIT_TEST(test_get_raw_file_type);
 	CPPUNIT_TEST(test_get_file_type);
+	CPPUNIT_TEST(test_get_file_stat);
 	CPPUNIT_TEST(test_path_exists);
 	CPPUNIT_TEST(test_is_dot_path);
 	CPPUNIT_TEST(test_is_dir_writable);
 	CPPUNIT_TEST(test_remove_dup_string);
+	CPPUNIT_TEST(test_join_input);
+	CPPUNIT_TEST(test_parse_size);
 	CPPUNIT_TEST(test_get_random);
+	CPPUNIT_TEST(test_random_engine);
+	CPPUNIT_TEST(test_random_filler);
 	CPPUNIT_TEST(test_timer1);
 	CPPUNIT_TEST(test_timer2);
+	CPPUNIT_TEST(test_get_page_size);
+	CPPUNIT_TEST(test_buffer);
+	CPPUNIT_TEST(test_buffer_thp);
 	CPPUNIT_TEST_SUITE_END();
 
 	private:
@@ -88,15 +209,24 @@ class UtilTest: public CPPUNIT_NS::TestFixture {
 	void test_is_abspath(void);
 	void test_is_windows(void);
 	void test_get_path_separator(void);
+	void test_get_mode_file_type(void);
 	void test_get_raw_file_type(void);
 	void test_get_file_type(void);
+	void test_get_file_stat(void);
 	void test_path_exists(void);
 	void test_is_dot_path(void);
 	void test_is_dir_writable(void);
 	void test_remove_dup_string(void);
+	void test_join_input(void);
+	void test_parse_size(void);
 	void test_get_random(void);
+	void test_random_engine(void);
+	void test_random_filler(void);
 	void test_timer1(void);
 	void test_timer2(void);
+	void test_get_page_size(void);
+	void test_buffer(void);
+	void test_buffer_thp(void);
 };
 #endif
 #endif // SRC_UTIL_H_
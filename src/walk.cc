@@ -0,0 +1,187 @@
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "./walk.h"
+
+namespace {
+#ifdef __linux__
+const size_t GETDENTS_BUFFER_SIZE = 32lu * 1024;
+
+struct linux_dirent64 {
+	ino64_t d_ino;
+	off64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1]; // variable length
+};
+#endif
+
+FileType get_dtype_file_type(unsigned char d_type) {
+	switch (d_type) {
+	case DT_DIR:
+		return FileType::Dir;
+	case DT_REG:
+		return FileType::Reg;
+	case DT_BLK:
+		[[fallthrough]];
+	case DT_CHR:
+		return FileType::Device;
+	case DT_LNK:
+		return FileType::Symlink;
+	default:
+		return FileType::Unsupported;
+	}
+}
+} // namespace
+
+Walker::Walker(void):
+	_frames{},
+	_depth(0),
+	_path{} {
+}
+
+Walker::~Walker(void) {
+	close_all();
+}
+
+void Walker::close_all(void) {
+	while (_depth > 0)
+		pop();
+}
+
+// open a directory relative to the current one, path buffer is updated
+// by the caller
+int Walker::push(int dirfd, const char* name, size_t path_len) {
+	auto fd = openat(dirfd, name,
+		O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	// frames and their buffers are reused across directories
+	if (_depth == _frames.size())
+		_frames.push_back({-1, {}, 0, 0, 0, nullptr});
+	auto& fr = _frames[_depth];
+	fr.fd = fd;
+	fr.pos = 0;
+	fr.end = 0;
+	fr.path_len = path_len;
+#ifdef __linux__
+	fr.buf.resize(GETDENTS_BUFFER_SIZE);
+	fr.dirp = nullptr;
+#else
+	fr.dirp = fdopendir(fd);
+	if (fr.dirp == nullptr) {
+		auto error = errno;
+		close(fd);
+		return -error;
+	}
+#endif
+	_depth++;
+	return 0;
+}
+
+void Walker::pop(void) {
+	assert(_depth > 0);
+	auto& fr = _frames[--_depth];
+#ifdef __linux__
+	close(fr.fd);
+#else
+	closedir(static_cast<DIR*>(fr.dirp)); // closes fd
+	fr.dirp = nullptr;
+#endif
+	fr.fd = -1;
+}
+
+// returns 1 with name and d_type set, 0 on end of directory
+int Walker::next(Frame& fr, const char*& name, unsigned char& d_type) {
+	while (1) {
+#ifdef __linux__
+		if (fr.pos >= fr.end) {
+			auto n = syscall(SYS_getdents64, fr.fd, fr.buf.data(),
+				fr.buf.size());
+			if (n < 0)
+				return -errno;
+			if (n == 0)
+				return 0;
+			fr.pos = 0;
+			fr.end = static_cast<size_t>(n);
+		}
+		auto d = reinterpret_cast<linux_dirent64*>(
+			fr.buf.data() + fr.pos);
+		fr.pos += d->d_reclen;
+		name = d->d_name;
+		d_type = d->d_type;
+#else
+		errno = 0;
+		auto d = readdir(static_cast<DIR*>(fr.dirp));
+		if (d == nullptr)
+			return errno ? -errno : 0;
+		name = d->d_name;
+		d_type = d->d_type;
+#endif
+		if (strcmp(name, ".") && strcmp(name, ".."))
+			return 1;
+	}
+}
+
+// only entries directly under root unless recursive
+int Walker::walk(const std::string& root, const walk_fn& fn, bool recursive) {
+	assert(_depth == 0);
+	_path = root;
+	if (!_path.ends_with('/'))
+		_path.push_back('/');
+	auto ret = push(AT_FDCWD, root.c_str(), _path.size());
+	if (ret < 0)
+		return ret;
+
+	while (_depth > 0) {
+		auto& fr = _frames[_depth - 1];
+		const char* name;
+		unsigned char d_type;
+		ret = next(fr, name, d_type);
+		if (ret < 0)
+			break;
+		if (ret == 0) {
+			pop();
+			continue;
+		}
+
+		_path.resize(fr.path_len);
+		_path.append(name);
+		auto t = get_dtype_file_type(d_type);
+		if (d_type == DT_UNKNOWN) {
+			struct stat st;
+			if (fstatat(fr.fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+				t = FileType::Unsupported;
+			else
+				t = get_mode_file_type(st.st_mode);
+		}
+		ret = fn(_path, t);
+		if (ret != 0)
+			break;
+
+		// pre-order, descend after the directory itself
+		if (recursive && t == FileType::Dir) {
+			_path.push_back('/');
+			ret = push(fr.fd, name, _path.size());
+			if (ret < 0)
+				break;
+		}
+	}
+
+	close_all();
+	return ret;
+}
+
+int walk_dir(const std::string& root, const walk_fn& fn) {
+	Walker walker;
+	return walker.walk(root, fn, true);
+}
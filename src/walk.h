@@ -0,0 +1,53 @@
+#ifndef SRC_WALK_H_
+#define SRC_WALK_H_
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <cassert>
+
+#include "./util.h"
+
+// returns 0 to continue, > 0 to stop walk, < 0 to fail walk
+typedef std::function<int(const std::string&, FileType)> walk_fn;
+
+// Walks a directory tree like std::filesystem::recursive_directory_iterator,
+// but uses dirfd relative operations and d_type (getdents64(2) on Linux),
+// and reuses a single path buffer for entries.
+class Walker {
+	public:
+	Walker(void);
+	Walker(const Walker&) = delete;
+	Walker& operator=(const Walker&) = delete;
+	~Walker(void);
+
+	int walk(const std::string&, const walk_fn&, bool);
+	// dirfd of the directory containing the entry passed to walk_fn
+	int get_dirfd(void) const {
+		assert(_depth > 0);
+		return _frames[_depth - 1].fd;
+	}
+
+	private:
+	struct Frame {
+		int fd;
+		std::vector<char> buf;
+		size_t pos;
+		size_t end;
+		size_t path_len;
+		void* dirp; // DIR* unless Linux
+	};
+
+	int push(int, const char*, size_t);
+	void pop(void);
+	int next(Frame&, const char*&, unsigned char&);
+	void close_all(void);
+
+	std::vector<Frame> _frames;
+	size_t _depth;
+	std::string _path;
+};
+
+int walk_dir(const std::string&, const walk_fn&);
+#endif // SRC_WALK_H_
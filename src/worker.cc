@@ -1,23 +1,30 @@
 #include <iostream>
 #include <sstream>
-#include <filesystem>
 #include <thread>
 #include <chrono>
 #include <exception>
+#include <utility>
+#include <map>
+#include <memory>
+#include <algorithm>
 
+#include <cstdint>
 #include <cerrno>
 #include <cassert>
 
 #include "./flist.h"
 #include "./log.h"
+#include "./scan.h"
+#include "./stream.h"
 #include "./thread.h"
 #include "./util.h"
+#include "./walk.h"
 #include "./worker.h"
 
 XThread::XThread(unsigned int gid, ThreadDir&& dir, ThreadStat&& stat):
 	_gid(gid),
-	_dir(dir),
-	_stat(stat),
+	_dir(std::move(dir)),
+	_stat(std::move(stat)),
 	_thread{},
 	_num_complete(0),
 	_num_interrupted(0),
@@ -28,59 +35,134 @@ bool XThread::is_write_done(void) const {
 	if (!is_writer() || opt::num_write_paths <= 0)
 		return false;
 	else
-		return get_dir().get_num_write_paths() >=
+		return get_dir().get_num_write_paths() +
+			get_dir().get_num_update_paths() >=
 			static_cast<unsigned long>(opt::num_write_paths);
 }
 
 namespace {
+// binary flist is sorted, so each input is a range of the mmap'd flist
+int setup_flist_binary(const std::vector<std::string>& input,
+	std::vector<std::shared_ptr<const Flist>>& fls) {
+	auto fl = std::make_shared<const MmapFlist>(opt::flist_file);
+	if (!fl->is_sorted()) {
+		std::cout << opt::flist_file << " not sorted" << std::endl;
+		return -EINVAL;
+	}
+
+	std::vector<std::pair<size_t, size_t>> rv;
+	for (const auto& f : input) {
+		auto r = get_flist_prefix_range(*fl, f);
+		rv.push_back(r);
+		fls.push_back(std::make_shared<const RangeFlist>(fl, r.first,
+			r.second));
+	}
+
+	// ranges can overlap, find the first path not in any range
+	std::sort(rv.begin(), rv.end());
+	size_t i = 0;
+	for (const auto& [begin, end] : rv) {
+		if (begin > i)
+			break;
+		i = std::max(i, end);
+	}
+	if (i < fl->size()) {
+		std::string buf;
+		std::cout << fl->get(i, buf) << " has no prefix in "
+			<< join_input(input) << std::endl;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+int setup_flist_text(const std::vector<std::string>& input,
+	std::vector<std::shared_ptr<const Flist>>& fls) {
+	std::shared_ptr<const PathTable> fl = load_flist_file(opt::flist_file);
+	std::vector<std::vector<size_t>> l;
+	size_t unmatched;
+	auto ret = assign_flist_prefix(*fl, input, opt::num_scanner, l,
+		unmatched);
+	if (ret < 0)
+		return ret;
+	if (unmatched < fl->size()) {
+		std::string buf;
+		std::cout << fl->get(unmatched, buf) << " has no prefix in "
+			<< join_input(input) << std::endl;
+		return -EINVAL;
+	}
+	// indices to a single path table, paths aren't copied per input
+	for (auto& v : l)
+		fls.push_back(std::make_shared<const IndexFlist>(fl,
+			std::move(v)));
+	return 0;
+}
+
+std::shared_ptr<const Flist> compress_flist(const Flist& fl) {
+	auto x = std::make_shared<FrontCodedFlist>();
+	std::string buf;
+	for (size_t i = 0; i < fl.size(); i++)
+		x->push_back(fl.get(i, buf));
+	x->shrink_to_fit();
+	xlog("flist compressed to %zu bytes", x->get_memory_size());
+	return x;
+}
+
 int setup_flist_impl(const std::vector<std::string>& input,
-	std::vector<std::vector<std::string>>& fls) {
+	std::vector<std::shared_ptr<const Flist>>& fls) {
 	assert(fls.empty());
-	for ([[maybe_unused]] const auto& f : input)
-		fls.push_back({});
-
+	auto binary = false;
 	if (!opt::flist_file.empty()) {
 		// load flist from flist file
 		assert(opt::path_iter != PathIter::Walk);
 		std::cout << "flist_file " << opt::flist_file << std::endl;
-		for (const auto& s : load_flist_file(opt::flist_file)) {
-			std::ostringstream ss;
-			auto found = false;
-			for (size_t i = 0; i < input.size(); i++) {
-				const auto& f = input[i];
-				if (s.starts_with(f)) {
-					fls[i].push_back(s);
-					found = true;
-					// no break, s can exist in multiple fls[i]
-				}
-				if (!found) {
-					ss << f;
-					if (i != input.size() - 1)
-						ss << ", ";
-				}
-			}
-			if (!found) {
-				std::cout << s << " has no prefix in "
-					<< ss.str() << std::endl;
-				return -EINVAL;
-			}
-		}
+		binary = is_binary_flist_file(opt::flist_file);
+		auto ret = binary ?
+			setup_flist_binary(input, fls) :
+			setup_flist_text(input, fls);
+		if (ret < 0)
+			return ret;
 	} else {
-		// initialize flist by walking input directories
+		// initialize flist by scanning input directories
+		std::vector<std::vector<ScanEntry>> sls;
+		auto ret = scan_flist(input, opt::ignore_dot, false,
+			opt::num_scanner, sls);
+		if (ret < 0)
+			return ret;
+		// pack all inputs into a single path table
+		size_t count = 0;
+		size_t bytes = 0;
+		for (const auto& v : sls) {
+			count += v.size();
+			for (const auto& x : v)
+				bytes += x.path.size() + 1;
+		}
+		auto fl = std::make_shared<PathTable>();
+		fl->reserve(count, bytes);
+		std::vector<std::pair<size_t, size_t>> rv;
 		for (size_t i = 0; i < input.size(); i++) {
-			const auto& f = input[i];
-			const auto l = init_flist(f, opt::ignore_dot);
-			std::cout << l.size() << " files scanned from " << f
-				<< std::endl;
-			fls[i] = l;
+			std::cout << sls[i].size() << " files scanned from "
+				<< input[i] << std::endl;
+			auto begin = fl->size();
+			for (const auto& x : sls[i])
+				fl->push_back(x.path);
+			rv.push_back({begin, fl->size()});
+			std::vector<ScanEntry>().swap(sls[i]);
 		}
+		for (const auto& [begin, end] : rv)
+			fls.push_back(std::make_shared<const RangeFlist>(fl,
+				begin, end));
 	}
 
+	// front code in-memory flists, mmap'd flist is in page cache
+	if (opt::flist_compress && !binary)
+		for (auto& fl : fls)
+			fl = compress_flist(*fl);
+
 	// don't allow empty flist as it results in spinning loop
 	for (size_t i = 0; i < fls.size(); i++) {
 		const auto& fl = fls[i];
-		if (!fl.empty()) {
-			std::cout << "flist " << input[i] << " " << fl.size()
+		if (fl->size() > 0) {
+			std::cout << "flist " << input[i] << " " << fl->size()
 				<< std::endl;
 		} else {
 			std::cout << "empty flist " << input[i] << std::endl;
@@ -92,13 +174,18 @@ int setup_flist_impl(const std::vector<std::string>& input,
 }
 
 int setup_flist(const std::vector<std::string>& input,
-	std::vector<std::vector<std::string>>& fls) {
+	std::vector<std::shared_ptr<const Flist>>& fls) {
 	fls.clear();
 	// setup flist for non-walk iterations
 	if (opt::path_iter == PathIter::Walk) {
 		for (const auto& f : input)
 			std::cout << "Walk " << f << std::endl;
 		return 0;
+	} else if (opt::flist_stream) {
+		// loaded while running
+		std::cout << "flist_file " << opt::flist_file << " (stream)"
+			<< std::endl;
+		return 0;
 	} else {
 		auto ret = setup_flist_impl(input, fls);
 		if (ret < 0)
@@ -108,6 +195,89 @@ int setup_flist(const std::vector<std::string>& input,
 	}
 }
 
+int shard_flist(const std::vector<std::unique_ptr<XThread>>& thrv,
+	const std::vector<std::shared_ptr<const Flist>>& fls,
+	std::vector<std::shared_ptr<const Flist>>& tfls,
+	std::vector<std::unique_ptr<FlistCursor>>& cursors,
+	std::vector<FlistCursor*>& tcursors) {
+	// readers and writers of an input are sharded separately
+	std::map<std::pair<size_t, bool>, std::vector<size_t>> groups;
+	for (size_t i = 0; i < thrv.size(); i++) {
+		const auto& thr = thrv[i];
+		groups[{thr->get_gid() % fls.size(), thr->is_reader()}]
+			.push_back(i);
+	}
+
+	for (const auto& [key, v] : groups) {
+		const auto& fl = fls[key.first];
+		auto siz = fl->size();
+		auto n = v.size();
+		if (opt::shard == Shard::Dynamic)
+			cursors.push_back(std::make_unique<FlistCursor>(siz));
+		for (size_t k = 0; k < n; k++) {
+			auto i = v[k];
+			switch (opt::shard) {
+			case Shard::Contiguous:
+				tfls[i] = std::make_shared<const RangeFlist>(fl,
+					siz * k / n, siz * (k + 1) / n);
+				break;
+			case Shard::Interleaved:
+				tfls[i] = std::make_shared<const StrideFlist>(fl,
+					k, n);
+				break;
+			case Shard::Dynamic:
+				tfls[i] = fl;
+				tcursors[i] = cursors.back().get();
+				break;
+			default:
+				tfls[i] = fl;
+				break;
+			}
+			// don't allow empty flist as it results in spinning loop
+			if (tfls[i]->size() == 0) {
+				std::cout << "empty shard #" << thrv[i]->get_gid()
+					<< std::endl;
+				return -EINVAL;
+			}
+		}
+	}
+	return 0;
+}
+
+int get_index_dist(size_t siz, std::shared_ptr<const IndexDist>& p) {
+	// alias table has 32 bit indices
+	if ((opt::path_iter == PathIter::Zipf ||
+		opt::path_iter == PathIter::Gaussian) && siz > UINT32_MAX) {
+		std::cout << "flist size " << siz << " too large for --path_iter"
+			<< std::endl;
+		return -EINVAL;
+	}
+	// heavy entries are spread over flist by engine seeded with --seed,
+	// gaussian is centered in flist on purpose
+	switch (opt::path_iter) {
+	case PathIter::Zipf:
+		p = std::make_shared<const PermutedDist>(
+			std::make_unique<const AliasDist>(
+			get_zipf_weights(siz, opt::zipf_theta)),
+			get_random_engine());
+		break;
+	case PathIter::Hotspot:
+		p = std::make_shared<const PermutedDist>(
+			std::make_unique<const HotspotDist>(siz,
+			opt::hotspot_files, opt::hotspot_ops),
+			get_random_engine());
+		break;
+	case PathIter::Gaussian:
+		p = std::make_shared<const AliasDist>(
+			get_gaussian_weights(siz, opt::gaussian_stddev));
+		break;
+	default:
+		p = nullptr;
+		break;
+	}
+	return 0;
+}
+
 void debug_print_complete(const XThread& thr, int repeat) {
 	std::ostringstream ss;
 	ss << get_thread_id() << " #" << thr.get_gid() << " "
@@ -170,7 +340,8 @@ void* monitor_handler(void* arg) {
 }
 
 void* worker_handler_impl(XThread& thr, const Dir& dir,
-	const std::string& input_path, const std::vector<std::string>& fl) {
+	const std::string& input_path, const Flist* fl, FlistCursor* cursor,
+	const IndexDist* dist, ChunkQueue* queue) {
 	auto d = opt::time_second;
 	auto repeat = 0;
 
@@ -180,76 +351,148 @@ void* worker_handler_impl(XThread& thr, const Dir& dir,
 	assert(thr.get_num_error() == 0);
 
 	thr.get_mut_stat().set_input_path(input_path);
+	std::string path;
+
+	// returns > 0 if interrupted or complete
+	auto handle_result = [&](int ret) {
+		if (ret < 0)
+			return ret;
+		if (interrupted) {
+			ret = flush_entry(thr);
+			if (ret < 0)
+				return ret;
+			thr.inc_num_interrupted();
+			return 1;
+		}
+		if (thr.get_stat().sec_elapsed(d)) {
+			ret = flush_entry(thr);
+			if (ret < 0)
+				return ret;
+			debug_print_complete(thr, repeat);
+			thr.inc_num_complete();
+			return 1;
+		}
+		return 0;
+	};
+
+	// returns > 0 if interrupted or complete
+	auto handle_entry = [&](const std::string& f) {
+		assert(f.starts_with(input_path));
+		if (thr.is_reader())
+			return handle_result(read_entry(f, thr));
+		else
+			return handle_result(write_entry(f, thr, dir));
+	};
+
+	// returns > 0 if interrupted or complete
+	auto handle_index = [&](size_t i) {
+		assert(fl);
+		size_t idx;
+		switch (opt::path_iter) {
+		case PathIter::Ordered:
+			idx = i;
+			break;
+		case PathIter::Reverse:
+			idx = fl->size() - 1 - i;
+			break;
+		case PathIter::Random:
+			idx = get_random<size_t>(0, fl->size());
+			break;
+		case PathIter::Zipf:
+		case PathIter::Hotspot:
+		case PathIter::Gaussian:
+			assert(dist);
+			assert(dist->size() == fl->size());
+			idx = dist->sample(get_random_engine());
+			break;
+		default:
+			return -EINVAL;
+		}
+		// reuses capacity, no allocation per entry
+		auto s = fl->get(idx, path);
+		if (s.data() != path.data())
+			path.assign(s);
+		if (thr.is_reader()) {
+			assert(path.starts_with(input_path));
+			return handle_result(read_flist_entry(path, *fl, idx,
+				thr));
+		}
+		return handle_entry(path);
+	};
+
+	// current batch if flist is shared via cursor
+	size_t batch_begin = 0;
+	size_t batch_end = 0;
+	unsigned long batch_pass = 0;
+	unsigned long pass = 0;
+	if (cursor) {
+		cursor->next(batch_begin, batch_end, batch_pass);
+		pass = batch_pass;
+	}
 
 	while (1) {
 		// either walk or select from input path
 		if (opt::path_iter == PathIter::Walk) {
-			for (const auto& x :
-				std::filesystem::recursive_directory_iterator(
-				input_path)) {
-				auto f = std::string(x.path());
-				assert(f.starts_with(input_path));
-				int ret;
-				if (thr.is_reader())
-					ret = read_entry(f, thr);
-				else
-					ret = write_entry(f, thr, dir);
-				if (ret < 0) {
+			auto ret = walk_dir(input_path,
+				[&](const std::string& f, FileType t) {
+					assert(f.starts_with(input_path));
+					if (thr.is_reader())
+						return handle_result(
+							read_walk_entry(f, t,
+							thr));
+					return handle_entry(f);
+				});
+			if (ret < 0) {
+				thr.inc_num_error();
+				return nullptr;
+			}
+		} else if (cursor) {
+			// a pass ends when shared cursor moves to the next pass
+			auto ret = 0;
+			while (ret == 0 && batch_pass == pass) {
+				for (auto i = batch_begin; i < batch_end && ret == 0;
+					i++)
+					ret = handle_index(i);
+				cursor->next(batch_begin, batch_end, batch_pass);
+			}
+			pass = batch_pass;
+			if (ret < 0) {
+				thr.inc_num_error();
+				return nullptr;
+			}
+		} else if (queue) {
+			// a pass of streamed flist, always ordered
+			std::shared_ptr<const Flist> chunk;
+			auto ret = 0;
+			while (ret == 0) {
+				auto n = queue->pop(chunk);
+				if (n < 0) {
 					thr.inc_num_error();
 					return nullptr;
 				}
-				if (interrupted) {
-					thr.inc_num_interrupted();
-					break;
+				if (n == 0)
+					break; // end of pass
+				for (size_t i = 0; i < chunk->size() && ret == 0;
+					i++) {
+					auto s = chunk->get(i, path);
+					if (s.data() != path.data())
+						path.assign(s);
+					ret = handle_entry(path);
 				}
-				if (thr.get_stat().sec_elapsed(d)) {
-					debug_print_complete(thr, repeat);
-					thr.inc_num_complete();
-					break;
-				}
-			}
-		} else {
-			for (size_t i = 0; i < fl.size(); i++) {
-				auto idx = -1;
-				switch (opt::path_iter) {
-				case PathIter::Ordered:
-					idx = static_cast<int>(i);
-					break;
-				case PathIter::Reverse:
-					idx = static_cast<int>(
-						fl.size() - 1 - i);
-					break;
-				case PathIter::Random:
-					idx = get_random<int>(0,
-						static_cast<int>(fl.size()));
-					break;
-				default:
-					break;
-				}
-				if (idx == -1) {
+				if (ret < 0) {
 					thr.inc_num_error();
 					return nullptr;
 				}
-				const auto& f = fl[idx];
-				assert(f.starts_with(input_path));
-				int ret;
-				if (thr.is_reader())
-					ret = read_entry(f, thr);
-				else
-					ret = write_entry(f, thr, dir);
+			}
+		} else {
+			for (size_t i = 0; i < fl->size(); i++) {
+				auto ret = handle_index(i);
 				if (ret < 0) {
 					thr.inc_num_error();
 					return nullptr;
 				}
-				if (interrupted) {
-					thr.inc_num_interrupted();
-					break;
-				}
-				if (thr.get_stat().sec_elapsed(d)) {
-					debug_print_complete(thr, repeat);
-					thr.inc_num_complete();
+				if (ret > 0)
 					break;
-				}
 			}
 		}
 		// return if interrupted or complete
@@ -268,6 +511,11 @@ void* worker_handler_impl(XThread& thr, const Dir& dir,
 		assert(opt::num_repeat > 0);
 		assert(repeat >= opt::num_repeat);
 	}
+	// wait for in-flight I/O if any
+	if (flush_entry(thr) < 0) {
+		thr.inc_num_error();
+		return nullptr;
+	}
 	debug_print_complete(thr, repeat);
 	thr.inc_num_complete();
 
@@ -275,14 +523,20 @@ void* worker_handler_impl(XThread& thr, const Dir& dir,
 }
 
 void* worker_handler(void* arg) {
-	auto [thr, dir, input_path, fl] =
+	const auto& [thr, dir, input_path, fl, cursor, dist, queue] =
 		*reinterpret_cast<thread_worker_arg*>(arg);
+	init_random_engine(opt::seed, thr->get_gid() + 1);
 	try {
-		auto ret = worker_handler_impl(*thr, *dir, input_path, fl);
+		auto ret = worker_handler_impl(*thr, *dir, input_path, fl,
+			cursor, dist, queue);
+		if (queue)
+			queue->close(); // let producer move on
 		thr->get_mut_stat().set_done();
 		thr->get_mut_stat().set_time_end();
 		return ret;
 	} catch (const std::exception& e) {
+		if (queue)
+			queue->close();
 		add_exception(e);
 		thr->inc_num_error();
 		print_exception(*thr, e);
@@ -310,12 +564,12 @@ int dispatch_worker(const std::vector<std::string>& input,
 
 	// number of readers and writers are 0 by default
 	if (opt::num_reader == 0 && opt::num_writer == 0) {
-		result = {0, 0, 0, 0, {}};
+		result = {0, 0, 0, 0, {}, {}};
 		return 0;
 	}
 
 	// initialize dir
-	Dir dir(opt::random_write_data);
+	Dir dir;
 
 	// initialize thread structure
 	auto num_thread = opt::num_reader + opt::num_writer;
@@ -330,25 +584,61 @@ int dispatch_worker(const std::vector<std::string>& input,
 	assert(thrv.size() == num_thread);
 
 	// setup flist
-	std::vector<std::vector<std::string>> fls;
+	std::vector<std::shared_ptr<const Flist>> fls;
 	auto ret = setup_flist(input, fls);
 	if (ret < 0)
 		return ret;
-	if (opt::path_iter == PathIter::Walk)
+	if (opt::path_iter == PathIter::Walk || opt::flist_stream)
 		assert(fls.empty());
 	else
 		assert(!fls.empty());
 
+	// split flist of each input among its readers or writers
+	std::vector<std::shared_ptr<const Flist>> tfls(num_thread);
+	std::vector<std::unique_ptr<FlistCursor>> cursors;
+	std::vector<FlistCursor*> tcursors(num_thread);
+	if (!fls.empty()) {
+		auto ret = shard_flist(thrv, fls, tfls, cursors, tcursors);
+		if (ret < 0)
+			return ret;
+	}
+
+	// skewed distributions only depend on flist size,
+	// so threads with the same size share a table
+	std::vector<std::shared_ptr<const IndexDist>> tdists(num_thread);
+	std::map<size_t, std::shared_ptr<const IndexDist>> dists;
+	for (unsigned long i = 0; i < num_thread; i++) {
+		if (!tfls[i])
+			continue;
+		auto siz = tfls[i]->size();
+		auto& p = dists[siz];
+		if (!p) {
+			auto ret = get_index_dist(siz, p);
+			if (ret < 0)
+				return ret;
+		}
+		tdists[i] = p;
+	}
+
+	// flist file is streamed to each thread in chunks
+	std::unique_ptr<FlistStream> stream;
+	if (opt::flist_stream)
+		stream = std::make_unique<FlistStream>(opt::flist_file, input);
+
 	// initialize thread argument
 	thread_monitor_arg marg;
 	std::vector<thread_worker_arg> argv;
 	for (unsigned long i = 0; i < num_thread; i++) {
 		const auto& thr = thrv[i];
 		const auto& input_path = input[thr->get_gid() % input.size()];
-		const auto& fl = fls.empty() ? std::vector<std::string>{} :
-			fls[thr->get_gid() % fls.size()];
+		const auto fl = tfls[i].get();
+		const auto cursor = tcursors[i];
+		const auto dist = tdists[i].get();
+		const auto queue = stream ? stream->add_consumer(
+			thr->get_gid() % input.size()) : nullptr;
 		marg.push_back(&thr->get_mut_stat());
-		argv.push_back({nullptr, &dir, input_path, fl});
+		argv.push_back({nullptr, &dir, input_path, fl, cursor, dist,
+			queue});
 	}
 
 	// create threads
@@ -361,6 +651,14 @@ int dispatch_worker(const std::vector<std::string>& input,
 		}
 		xlog("%s", "monitor created");
 	}
+	if (stream) {
+		auto ret = stream->start();
+		if (ret) {
+			xlog("flist stream create failed %d", ret);
+			return ret;
+		}
+		xlog("%s", "flist stream created");
+	}
 	for (unsigned long i = 0; i < num_thread; i++) {
 		const auto& thr = thrv[i];
 		auto ret = thr->thread_create_worker(&argv[i]);
@@ -389,6 +687,14 @@ int dispatch_worker(const std::vector<std::string>& input,
 		}
 		xlog("%s", "monitor joined");
 	}
+	if (stream) {
+		auto ret = stream->join();
+		if (ret) {
+			xlog("flist stream join failed %d", ret);
+			return ret;
+		}
+		xlog("%s", "flist stream joined");
+	}
 
 	// collect result
 	unsigned long num_complete = 0;
@@ -407,7 +713,12 @@ int dispatch_worker(const std::vector<std::string>& input,
 		tdv.push_back(&thr->get_dir());
 		tsv.push_back(thr->get_stat());
 	}
-	result = {num_complete, num_interrupted, num_error,
-		cleanup_write_paths(tdv), tsv};
+	unsigned long num_remain = 0;
+	UnlinkStat us{};
+	ret = cleanup_write_paths(tdv, num_remain, us);
+	if (ret < 0)
+		return ret;
+	result = {num_complete, num_interrupted, num_error, num_remain, tsv,
+		us};
 	return 0;
 }
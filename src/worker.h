@@ -7,13 +7,16 @@
 #include <memory>
 
 #include "./dir.h"
+#include "./dist.h"
+#include "./flist.h"
 #include "./global.h"
 #include "./stat.h"
+#include "./stream.h"
 #include "./thread.h"
 
 typedef std::vector<const ThreadStat*> thread_monitor_arg;
-typedef std::tuple<XThread*, Dir*, std::string, std::vector<std::string>>
-	thread_worker_arg;
+typedef std::tuple<XThread*, Dir*, std::string, const Flist*, FlistCursor*,
+	const IndexDist*, ChunkQueue*> thread_worker_arg;
 
 class XThread {
 	public:
@@ -91,6 +94,6 @@ class XThread {
 };
 
 typedef std::tuple<unsigned long, unsigned long, unsigned long, unsigned long,
-	std::vector<ThreadStat>> dispatch_res;
+	std::vector<ThreadStat>, UnlinkStat> dispatch_res;
 int dispatch_worker(const std::vector<std::string>&, dispatch_res&);
 #endif // SRC_WORKER_H_